@@ -0,0 +1,219 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "cpu_dispatch.hpp"
+#include "gap_buffer.hpp"
+#include "huge_page_allocator.hpp"
+#include "slab_allocator.hpp"
+
+
+/**
+ * Runs \p fn and gets the time it took in milliseconds.
+ */
+template <typename F>
+double time_ms(F fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+
+void report(std::string_view name, double ms) {
+    std::cout << name << ": " << ms << " ms\n";
+}
+
+
+/**
+ * Counts the data TLB misses of the process in user space. The counter is
+ * unavailable if the kernel or the machine does not expose it, e.g. in a
+ * virtual machine, in which case count() is -1.
+ */
+class tlb_misses {
+  private:
+    int _fd;
+
+  public:
+    tlb_misses() {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                      PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                      PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        _fd = ::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+
+    tlb_misses(const tlb_misses&) = delete;
+    tlb_misses& operator=(const tlb_misses&) = delete;
+
+    ~tlb_misses() {
+        if (_fd >= 0) { ::close(_fd); }
+    }
+
+    int64_t count() const {
+        int64_t value = -1;
+        if (_fd < 0 || ::read(_fd, &value, sizeof(value)) != sizeof(value)) {
+            return -1;
+        }
+        return value;
+    }
+};
+
+
+/**
+ * Creates a million tiny buffers, edits them like spreadsheet cells and
+ * destroys them, which is dominated by the allocations.
+ */
+template <typename Allocator>
+double tiny_buffers(const Allocator& alloc) {
+    using namespace std::string_view_literals;
+    constexpr int64_t count = 1'000'000;
+    return time_ms([&] {
+        std::vector<gap_buffer<char, Allocator>> cells;
+        cells.reserve(count);
+        for (int64_t i = 0; i < count; ++i) {
+            auto& cell = cells.emplace_back(alloc);
+            cell.insert(0, "=SUM()"sv);
+            cell.insert(5, "A1:A9"sv);
+        }
+        for (int64_t i = 0; i < count; i += 3) { cells[i].clear(); }
+    });
+}
+
+
+void bench_slab() {
+    report("1M tiny buffers, std::allocator",
+           tiny_buffers(std::allocator<char>{}));
+    slab_arena arena;
+    report("1M tiny buffers, slab_allocator",
+           tiny_buffers(slab_allocator<char>{arena}));
+    report("slab_arena::release", time_ms([&] { arena.release(); }));
+}
+
+
+/**
+ * Moves the gap across a 512 MiB buffer and scans it, reporting the time
+ * and the data TLB misses.
+ */
+template <typename Allocator>
+void large_buffer(std::string_view name) {
+    constexpr int64_t size = int64_t{512} << 20;
+    gap_buffer<char, Allocator> buf;
+    buf.insert_n(0, size, 'a');
+    tlb_misses misses;
+    int64_t before = misses.count();
+    double ms = time_ms([&] {
+        for (int64_t i = 1; i <= 16; ++i) {
+            buf.insert(i * 7919 % 16 * (size / 16), '\n');
+            buf.rfind('z', buf.size());
+        }
+    });
+    int64_t after = misses.count();
+    std::cout << name << ": " << ms << " ms, ";
+    if (before < 0 || after < 0) {
+        std::cout << "dTLB misses unavailable\n";
+    } else {
+        std::cout << after - before << " dTLB misses\n";
+    }
+}
+
+
+void bench_huge_pages() {
+    large_buffer<std::allocator<char>>("512 MiB buffer, std::allocator");
+    large_buffer<huge_page_allocator<char>>(
+        "512 MiB buffer, huge_page_allocator");
+}
+
+
+/**
+ * Forces every tier of the byte kernels in turn and times the searches and
+ * the line counting of a 64 MiB buffer with it.
+ */
+void bench_tiers() {
+    using namespace std::string_view_literals;
+    using kernels::cpu_tier;
+    std::string line = "    int64_t offset = begin + block_size(i);\n";
+    gap_buffer<char> buf;
+    for (int64_t size = 0; size < int64_t{64} << 20; size += line.size()) {
+        buf.push_back(std::string_view{line});
+    }
+    buf.insert(buf.size() / 2, "gap"sv);
+    for (auto [tier, name] : {std::pair{cpu_tier::scalar, "scalar"},
+                              std::pair{cpu_tier::sse2, "sse2"},
+                              std::pair{cpu_tier::avx2, "avx2"},
+                              std::pair{cpu_tier::avx512, "avx512"}}) {
+        if (!kernels::force_tier(tier)) {
+            std::cout << name << ": not supported\n";
+            continue;
+        }
+        std::cout << name << ": ";
+        std::cout << "find " << time_ms([&] { buf.find("block_sizes"sv); })
+                  << " ms, rfind "
+                  << time_ms([&] { buf.rfind('#', buf.size()); })
+                  << " ms, line count "
+                  << time_ms([&] { buf.recount_stats(); }) << " ms\n";
+    }
+    kernels::force_tier(kernels::best_tier());
+}
+
+
+/**
+ * A buffer without a move constructor, so that containers copy it.
+ */
+struct copy_only_buffer {
+    gap_buffer<char> buf;
+
+    copy_only_buffer() = default;
+    copy_only_buffer(const copy_only_buffer&) = default;
+    copy_only_buffer& operator=(const copy_only_buffer&) = default;
+};
+
+
+/**
+ * Grows a vector of 100k buffers of 1 KiB one by one and rotates it, which
+ * relocates every buffer many times.
+ */
+template <typename Buffer, typename Content>
+double container_of_buffers(Content content) {
+    std::string text(1024, 'x');
+    return time_ms([&] {
+        std::vector<Buffer> bufs;
+        for (int64_t i = 0; i < 100'000; ++i) {
+            std::invoke(content, bufs.emplace_back())
+                .insert(0, std::string_view{text});
+        }
+        std::ranges::rotate(bufs, bufs.begin() + bufs.size() / 3);
+    });
+}
+
+
+void bench_moves() {
+    report("vector of 100k buffers, moved",
+           container_of_buffers<gap_buffer<char>>(std::identity{}));
+    report("vector of 100k buffers, copied",
+           container_of_buffers<copy_only_buffer>(&copy_only_buffer::buf));
+}
+
+
+int main() {
+    bench_slab();
+    bench_huge_pages();
+    bench_tiers();
+    bench_moves();
+    return 0;
+}
@@ -0,0 +1,221 @@
+#pragma once
+
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+
+/**
+ * @brief      This class describes a partition of a content into consecutive
+ *             blocks, each carrying a payload. It is the common base of the
+ *             incremental indexes built over a gap buffer. Blocks move
+ *             together with the content, i.e. an edit only changes the
+ *             blocks it touches, so the payloads of all the other blocks stay
+ *             valid. Blocks emptied by an edit are dropped and blocks which
+ *             grew beyond twice the nominal block size are split. Block
+ *             offsets are kept in a Fenwick tree, so locating a block is
+ *             O(log n).
+ *
+ * @tparam     P     The type of the payload held by every block.
+ */
+template <typename P>
+class block_map {
+  private:
+    struct block {
+        int64_t size{0};
+        P payload{};
+    };
+
+  public:
+    /**
+     * @brief      Describes the blocks affected by an edit. Their payloads
+     *             have to be recomputed by the owner of the map.
+     */
+    struct touched {
+        int64_t first;
+        int64_t last;
+        bool reindexed;
+    };
+
+  private:
+    std::vector<block> _blocks{};
+    std::vector<int64_t> _tree{};
+    int64_t _block_size;
+
+
+  private:
+    /**
+     * @brief      Rebuilds the Fenwick tree of block sizes in O(n).
+     */
+    constexpr void rebuild_tree() {
+        _tree.assign(_blocks.size() + 1, 0);
+        for (size_t i = 1; i < _tree.size(); ++i) {
+            _tree[i] += _blocks[i - 1].size;
+            size_t parent = i + (i & -i);
+            if (parent < _tree.size()) { _tree[parent] += _tree[i]; }
+        }
+    }
+
+
+    /**
+     * @brief      Changes the size of a block keeping the Fenwick tree up to
+     *             date.
+     *
+     * @param[in]  i      The block index.
+     * @param[in]  delta  The size change.
+     */
+    constexpr void resize_block(int64_t i, int64_t delta) {
+        _blocks[i].size += delta;
+        for (size_t j = i + 1; j < _tree.size(); j += j & -j) {
+            _tree[j] += delta;
+        }
+    }
+
+
+  public:
+    /**
+     * @brief      Constructs a new instance of block map.
+     *
+     * @param[in]  total       The size of the partitioned content.
+     * @param[in]  block_size  The nominal size of a block.
+     */
+    constexpr block_map(int64_t total, int64_t block_size)
+        : _block_size{std::max<int64_t>(block_size, 1)} {
+        do {
+            int64_t size = std::min(total, _block_size);
+            _blocks.push_back({size});
+            total -= size;
+        } while (total > 0);
+        rebuild_tree();
+    }
+
+
+  public:
+    /**
+     * @brief      Gets the number of blocks. There is always at least one,
+     *             possibly empty, block.
+     *
+     * @return     The number of blocks.
+     */
+    constexpr int64_t size() const { return _blocks.size(); }
+
+
+    /**
+     * @brief      Gets the size of a block.
+     *
+     * @param[in]  i     The block index.
+     *
+     * @return     The size of the block.
+     */
+    constexpr int64_t block_size(int64_t i) const { return _blocks[i].size; }
+
+
+    /**
+     * @brief      Gets the offset at which a block starts.
+     *
+     * @param[in]  i     The block index belonging to [0, size()].
+     *
+     * @return     The offset of the first element of the block.
+     */
+    constexpr int64_t block_begin(int64_t i) const {
+        int64_t offset = 0;
+        for (; i > 0; i -= i & -i) { offset += _tree[i]; }
+        return offset;
+    }
+
+
+    /**
+     * @brief      Gets the payload of a block.
+     *
+     * @param[in]  i     The block index.
+     *
+     * @return     A reference to the payload.
+     */
+    constexpr P& payload(int64_t i) { return _blocks[i].payload; }
+
+
+    /**
+     * @brief      Gets the payload of a block.
+     *
+     * @param[in]  i     The block index.
+     *
+     * @return     A reference to the payload.
+     */
+    constexpr const P& payload(int64_t i) const { return _blocks[i].payload; }
+
+
+    /**
+     * @brief      Finds the block containing the given offset. The end of the
+     *             content belongs to the last block.
+     *
+     * @param[in]  offset  The offset belonging to [0, content size].
+     *
+     * @return     std::pair containing the block index and its offset.
+     */
+    constexpr std::pair<int64_t, int64_t> locate(int64_t offset) const {
+        int64_t i = 0, rest = offset;
+        for (int64_t step = std::bit_floor(_blocks.size()); step > 0;
+             step /= 2) {
+            if (i + step <= size() && _tree[i + step] <= rest) {
+                i += step;
+                rest -= _tree[i];
+            }
+        }
+        if (i == size()) {
+            --i;
+            rest += _blocks[i].size;
+        }
+        return {i, offset - rest};
+    }
+
+
+    /**
+     * @brief      Applies an edit to the partition. Removed elements are
+     *             taken out of the blocks they belonged to and inserted ones
+     *             are added to the block containing \p offset.
+     *
+     * @param[in]  offset    The offset of the edit.
+     * @param[in]  removed   The number of removed elements.
+     * @param[in]  inserted  The number of inserted elements.
+     *
+     * @return     The range of blocks whose payloads have to be recomputed.
+     *             If reindexed is set, the indexes of the blocks following
+     *             the range have changed.
+     */
+    constexpr touched edit(int64_t offset, int64_t removed, int64_t inserted) {
+        auto [first, begin] = locate(offset);
+        int64_t last = first;
+        int64_t take = std::min(removed, block_size(first) - (offset - begin));
+        resize_block(first, inserted - take);
+        for (removed -= take; removed > 0; removed -= take) {
+            take = std::min(removed, block_size(++last));
+            resize_block(last, -take);
+        }
+        std::vector<block> rebuilt;
+        for (int64_t i = first; i <= last; ++i) {
+            int64_t size = block_size(i);
+            if (size > 2 * _block_size) {
+                for (; size >= 2 * _block_size; size -= _block_size) {
+                    rebuilt.push_back({_block_size});
+                }
+            }
+            if (size > 0) { rebuilt.push_back({size}); }
+        }
+        if (rebuilt.empty() && size() == last - first + 1) {
+            rebuilt.push_back({0});
+        }
+        if (std::ranges::equal(rebuilt, std::span{_blocks}.subspan(
+                                            first, last - first + 1),
+                               {}, &block::size, &block::size)) {
+            return {first, last + 1, false};
+        }
+        _blocks.erase(_blocks.begin() + first, _blocks.begin() + last + 1);
+        _blocks.insert(_blocks.begin() + first, rebuilt.begin(), rebuilt.end());
+        rebuild_tree();
+        return {first, first + int64_t(rebuilt.size()), true};
+    }
+};
@@ -0,0 +1,317 @@
+#pragma once
+
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "block_map.hpp"
+#include "gap_buffer.hpp"
+
+
+/**
+ * @brief      This class describes an index answering bracket matching
+ *             queries over a gap_buffer<char> in O(log n). The content is
+ *             split into blocks (see block_map) and every block is summarised
+ *             by its bracket depth profile. The summaries are kept in a
+ *             segment tree, so a query only scans the two blocks at its ends.
+ *             All of (, [ and { open a scope and all of ), ] and } close one,
+ *             i.e. mismatched kinds are not told apart. Within a batch (see
+ *             gap_buffer::begin_batch()) the index is up to date only once
+ *             the pending edits have been delivered.
+ */
+class bracket_index : public buffer_subscription<gap_buffer<char>> {
+  private:
+    /**
+     * @brief      Depth profile of a piece of content, that is its depth
+     *             change and the minimal depth change over its prefixes
+     *             (including the empty one). The maximal depth change over
+     *             its suffixes is then net - min_prefix.
+     */
+    struct summary {
+        int64_t net{0};
+        int64_t min_prefix{0};
+
+        constexpr summary operator+(const summary& rhs) const {
+            return {net + rhs.net, std::min(min_prefix, net + rhs.min_prefix)};
+        }
+
+        constexpr int64_t max_suffix() const { return net - min_prefix; }
+    };
+
+  private:
+    block_map<summary> _blocks;
+    std::vector<summary> _tree{};
+    int64_t _leaves{0};
+
+
+  private:
+    /**
+     * @brief      Gets the depth change caused by a character.
+     *
+     * @param[in]  c     The character.
+     *
+     * @return     1 for an opening bracket, -1 for a closing one and 0
+     *             otherwise.
+     */
+    static constexpr int64_t depth(char c) {
+        switch (c) {
+            case '(':
+            case '[':
+            case '{': return 1;
+            case ')':
+            case ']':
+            case '}': return -1;
+            default: return 0;
+        }
+    }
+
+
+    /**
+     * @brief      Recomputes the summary of a block from the buffer content.
+     *
+     * @param[in]  i     The block index.
+     */
+    constexpr void summarize(int64_t i) {
+        summary s{};
+        for (auto seg :
+             _buf->segments(_blocks.block_begin(i), _blocks.block_size(i))) {
+            for (char c : seg) {
+                s.net += depth(c);
+                s.min_prefix = std::min(s.min_prefix, s.net);
+            }
+        }
+        _blocks.payload(i) = s;
+    }
+
+
+    /**
+     * @brief      Copies the summary of a block into its leaf and recomputes
+     *             the inner nodes lying above it.
+     *
+     * @param[in]  i     The block index.
+     */
+    constexpr void update_path(int64_t i) {
+        _tree[_leaves + i] = _blocks.payload(i);
+        for (i = (_leaves + i) / 2; i > 0; i /= 2) {
+            _tree[i] = _tree[2 * i] + _tree[2 * i + 1];
+        }
+    }
+
+
+    /**
+     * @brief      Rebuilds the whole segment tree out of the block payloads.
+     */
+    constexpr void rebuild_tree() {
+        _leaves = std::bit_ceil(uint64_t(_blocks.size()));
+        _tree.assign(2 * _leaves, summary{});
+        for (int64_t i = 0; i < _blocks.size(); ++i) {
+            _tree[_leaves + i] = _blocks.payload(i);
+        }
+        for (int64_t i = _leaves - 1; i > 0; --i) {
+            _tree[i] = _tree[2 * i] + _tree[2 * i + 1];
+        }
+    }
+
+
+    /**
+     * @brief      Finds the first position q >= \p from such that the depth
+     *             change over [\p from, q] is -1.
+     *
+     * @param[in]  from  The position the search starts at.
+     *
+     * @return     The found position, if any.
+     */
+    constexpr std::optional<int64_t> find_forward(int64_t from) {
+        auto [block, begin] = _blocks.locate(from);
+        int64_t run = 0;
+        auto scan = [&](int64_t first, int64_t last) -> std::optional<int64_t> {
+            for (auto seg : _buf->segments(first, last - first)) {
+                for (char c : seg) {
+                    if ((run += depth(c)) == -1) { return first; }
+                    ++first;
+                }
+            }
+            return std::nullopt;
+        };
+        if (auto q = scan(from, begin + _blocks.block_size(block))) {
+            return q;
+        }
+        std::vector<int64_t> right_nodes;
+        int64_t node = -1;
+        for (int64_t l = _leaves + block + 1, r = 2 * _leaves; l < r;
+             l /= 2, r /= 2) {
+            if (l & 1) {
+                if (run + _tree[l].min_prefix <= -1) {
+                    node = l;
+                    break;
+                }
+                run += _tree[l++].net;
+            }
+            if (r & 1) { right_nodes.push_back(--r); }
+        }
+        for (auto it = right_nodes.rbegin();
+             node < 0 && it != right_nodes.rend(); ++it) {
+            if (run + _tree[*it].min_prefix <= -1) {
+                node = *it;
+            } else {
+                run += _tree[*it].net;
+            }
+        }
+        if (node < 0) { return std::nullopt; }
+        while (node < _leaves) {
+            if (run + _tree[2 * node].min_prefix <= -1) {
+                node = 2 * node;
+            } else {
+                run += _tree[2 * node].net;
+                node = 2 * node + 1;
+            }
+        }
+        block = node - _leaves;
+        begin = _blocks.block_begin(block);
+        return scan(begin, begin + _blocks.block_size(block));
+    }
+
+
+    /**
+     * @brief      Finds the last position q < \p to such that the depth
+     *             change over [q, \p to) is 1.
+     *
+     * @param[in]  to    The position the search ends at.
+     *
+     * @return     The found position, if any.
+     */
+    constexpr std::optional<int64_t> find_backward(int64_t to) {
+        auto [block, begin] = _blocks.locate(to);
+        int64_t run = 0;
+        auto scan = [&](int64_t first, int64_t last) -> std::optional<int64_t> {
+            auto segs = _buf->segments(first, last - first);
+            for (auto seg : {segs[1], segs[0]}) {
+                for (char c : seg | std::views::reverse) {
+                    --last;
+                    if ((run += depth(c)) == 1) { return last; }
+                }
+            }
+            return std::nullopt;
+        };
+        if (auto q = scan(begin, to)) { return q; }
+        std::vector<int64_t> left_nodes;
+        int64_t node = -1;
+        for (int64_t l = _leaves, r = _leaves + block; l < r; l /= 2, r /= 2) {
+            if (r & 1) {
+                if (run + _tree[--r].max_suffix() >= 1) {
+                    node = r;
+                    break;
+                }
+                run += _tree[r].net;
+            }
+            if (l & 1) { left_nodes.push_back(l++); }
+        }
+        for (auto it = left_nodes.rbegin();
+             node < 0 && it != left_nodes.rend(); ++it) {
+            if (run + _tree[*it].max_suffix() >= 1) {
+                node = *it;
+            } else {
+                run += _tree[*it].net;
+            }
+        }
+        if (node < 0) { return std::nullopt; }
+        while (node < _leaves) {
+            if (run + _tree[2 * node + 1].max_suffix() >= 1) {
+                node = 2 * node + 1;
+            } else {
+                run += _tree[2 * node + 1].net;
+                node = 2 * node;
+            }
+        }
+        block = node - _leaves;
+        begin = _blocks.block_begin(block);
+        return scan(begin, begin + _blocks.block_size(block));
+    }
+
+
+  public:
+    /**
+     * @brief      Constructs a new instance of bracket index over the given
+     *             buffer. The buffer has to outlive the index.
+     *
+     * @param      buf         The indexed buffer.
+     * @param[in]  block_size  The nominal size of a block.
+     */
+    constexpr bracket_index(gap_buffer<char>& buf, int64_t block_size = 4096)
+        : buffer_subscription{buf}, _blocks{buf.size(), block_size} {
+        for (int64_t i = 0; i < _blocks.size(); ++i) { summarize(i); }
+        rebuild_tree();
+    }
+
+
+    /**
+     * @brief      Destroys the object. The empty body works around GCC 12,
+     *             which does not evaluate the implicit virtual destructor in
+     *             constant expressions.
+     */
+    constexpr ~bracket_index() override {}
+
+
+  public:
+    /**
+     * @brief      Updates the index after the buffer has been edited.
+     *
+     * @param[in]  offset    The content index at which the edit happened.
+     * @param[in]  removed   The number of removed characters.
+     * @param[in]  inserted  The number of inserted characters.
+     */
+    constexpr void on_edit(int64_t offset, int64_t removed,
+                           int64_t inserted) override {
+        auto [first, last, reindexed] =
+            _blocks.edit(offset, removed, inserted);
+        for (int64_t i = first; i < last; ++i) { summarize(i); }
+        if (reindexed) {
+            rebuild_tree();
+            return;
+        }
+        for (int64_t i = first; i < last; ++i) { update_path(i); }
+    }
+
+
+    /**
+     * @brief      Finds the bracket matching the one at the given position.
+     *
+     * @param[in]  pos   The position of a bracket.
+     *
+     * @return     The position of the matching bracket. Empty if there is no
+     *             bracket at \p pos or it is unmatched.
+     */
+    constexpr std::optional<int64_t> match(int64_t pos) {
+        if (pos < 0 || pos >= _buf->size()) { return std::nullopt; }
+        auto [left, right] = _buf->segments(pos, 1);
+        switch (depth(left.empty() ? right.front() : left.front())) {
+            case 1: return find_forward(pos + 1);
+            case -1: return find_backward(pos);
+            default: return std::nullopt;
+        }
+    }
+
+
+    /**
+     * @brief      Finds the innermost pair of brackets enclosing the given
+     *             position, that is the place between the elements
+     *             \p pos - 1 and \p pos.
+     *
+     * @param[in]  pos   The position belonging to [0, size()].
+     *
+     * @return     std::pair containing the positions of the opening and
+     *             closing brackets. Empty if the position is not enclosed.
+     */
+    constexpr std::optional<std::pair<int64_t, int64_t>> enclosing(
+        int64_t pos) {
+        auto open = find_backward(pos);
+        if (!open) { return std::nullopt; }
+        auto close = find_forward(pos);
+        if (!close) { return std::nullopt; }
+        return std::make_pair(*open, *close);
+    }
+};
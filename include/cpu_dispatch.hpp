@@ -0,0 +1,328 @@
+#pragma once
+
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <utility>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define REFFUB_X86_DISPATCH 1
+#endif
+
+
+/**
+ * @brief      Run time selection of the byte kernels used by
+ *             gap_buffer<char>. The binary is built for the baseline
+ *             instruction set and every wider tier is compiled with a target
+ *             attribute; at startup the widest tier the CPU supports is
+ *             bound. SSE4.2 is not a tier of its own, as its string
+ *             instructions are slower than the SSE2 compares for single
+ *             byte scans. Moves are left to memmove, which glibc already
+ *             dispatches the same way.
+ */
+namespace kernels {
+
+
+/**
+ * @brief      The instruction set tiers, from the narrowest.
+ */
+enum class cpu_tier { scalar, sse2, avx2, avx512 };
+
+
+/**
+ * @brief      A set of byte kernels of one tier.
+ */
+struct byte_kernels {
+    cpu_tier tier;
+    // The index of the first occurrence of a byte, or -1.
+    int64_t (*find)(const char* p, int64_t n, char c);
+    // The number of occurrences of a byte.
+    int64_t (*count)(const char* p, int64_t n, char c);
+    // See kernels::rcount().
+    std::pair<int64_t, int64_t> (*rcount)(const char* p, int64_t n, char c,
+                                          int64_t limit);
+    // The index of the first differing byte, or n.
+    int64_t (*mismatch)(const char* a, const char* b, int64_t n);
+};
+
+
+namespace scalar {
+
+
+inline int64_t find(const char* p, int64_t n, char c) {
+    for (int64_t i = 0; i < n; ++i) {
+        if (p[i] == c) { return i; }
+    }
+    return -1;
+}
+
+
+inline int64_t count(const char* p, int64_t n, char c) {
+    int64_t count = 0;
+    for (int64_t i = 0; i < n; ++i) { count += p[i] == c; }
+    return count;
+}
+
+
+inline std::pair<int64_t, int64_t> rcount(const char* p, int64_t n, char c,
+                                          int64_t limit) {
+    int64_t count = 0, last = -1;
+    for (int64_t i = n - 1; i >= 0 && count < limit; --i) {
+        if (p[i] == c) { ++count, last = i; }
+    }
+    return {count, last};
+}
+
+
+inline int64_t mismatch(const char* a, const char* b, int64_t n) {
+    int64_t i = 0;
+    while (i < n && a[i] == b[i]) { ++i; }
+    return i;
+}
+
+
+}  // namespace scalar
+
+
+#if defined(REFFUB_X86_DISPATCH)
+/**
+ * Defines the kernels of a tier in namespace NAME, compiled for TARGET. The
+ * vectors hold W bytes, LOAD(p) loads one and EQ(x, y) gives the bit mask of
+ * the equal bytes of two vectors. The tails go to the scalar kernels.
+ */
+#define REFFUB_BYTE_KERNELS(NAME, TARGET, W, LOAD, SPLAT, EQ)                \
+    namespace NAME {                                                         \
+    [[gnu::target(TARGET)]] inline int64_t find(const char* p, int64_t n,    \
+                                                char c) {                    \
+        auto needle = SPLAT(c);                                              \
+        int64_t i = 0;                                                       \
+        for (; n - i >= W; i += W) {                                         \
+            if (uint64_t m = EQ(LOAD(p + i), needle)) {                      \
+                return i + std::countr_zero(m);                              \
+            }                                                                \
+        }                                                                    \
+        int64_t hit = scalar::find(p + i, n - i, c);                         \
+        return hit < 0 ? -1 : i + hit;                                       \
+    }                                                                        \
+                                                                             \
+    [[gnu::target(TARGET)]] inline int64_t count(const char* p, int64_t n,   \
+                                                 char c) {                   \
+        auto needle = SPLAT(c);                                              \
+        int64_t i = 0, count = 0;                                            \
+        for (; n - i >= W; i += W) {                                         \
+            count += std::popcount(uint64_t(EQ(LOAD(p + i), needle)));       \
+        }                                                                    \
+        return count + scalar::count(p + i, n - i, c);                       \
+    }                                                                        \
+                                                                             \
+    [[gnu::target(TARGET)]] inline std::pair<int64_t, int64_t> rcount(       \
+        const char* p, int64_t n, char c, int64_t limit) {                   \
+        auto needle = SPLAT(c);                                              \
+        int64_t count = 0, last = -1;                                        \
+        for (; n >= W && count < limit; n -= W) {                            \
+            uint64_t m = EQ(LOAD(p + n - W), needle);                        \
+            if (m == 0) { continue; }                                        \
+            if (count + std::popcount(m) < limit) {                          \
+                count += std::popcount(m);                                   \
+                last = n - W + std::countr_zero(m);                          \
+                continue;                                                    \
+            }                                                                \
+            while (true) {                                                   \
+                int64_t bit = std::bit_width(m) - 1;                         \
+                if (++count == limit) { return {count, n - W + bit}; }       \
+                m ^= uint64_t{1} << bit;                                     \
+            }                                                                \
+        }                                                                    \
+        auto [more, tail_last] = scalar::rcount(p, n, c, limit - count);     \
+        return {count + more, more > 0 ? tail_last : last};                  \
+    }                                                                        \
+                                                                             \
+    [[gnu::target(TARGET)]] inline int64_t mismatch(const char* a,           \
+                                                    const char* b,           \
+                                                    int64_t n) {             \
+        constexpr uint64_t all = ~uint64_t{0} >> (64 - W);                   \
+        int64_t i = 0;                                                       \
+        for (; n - i >= W; i += W) {                                         \
+            if (uint64_t m = ~EQ(LOAD(a + i), LOAD(b + i)) & all) {          \
+                return i + std::countr_zero(m);                              \
+            }                                                                \
+        }                                                                    \
+        return i + scalar::mismatch(a + i, b + i, n - i);                    \
+    }                                                                        \
+    }
+
+
+#define REFFUB_SSE2_LOAD(p) \
+    _mm_loadu_si128(reinterpret_cast<const __m128i*>(p))
+#define REFFUB_SSE2_EQ(x, y) \
+    uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y))))
+REFFUB_BYTE_KERNELS(sse2, "sse2", 16, REFFUB_SSE2_LOAD, _mm_set1_epi8,
+                    REFFUB_SSE2_EQ)
+
+#define REFFUB_AVX2_LOAD(p) \
+    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))
+#define REFFUB_AVX2_EQ(x, y) \
+    uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y))))
+REFFUB_BYTE_KERNELS(avx2, "avx2", 32, REFFUB_AVX2_LOAD, _mm256_set1_epi8,
+                    REFFUB_AVX2_EQ)
+
+#define REFFUB_AVX512_LOAD(p) _mm512_loadu_si512(p)
+#define REFFUB_AVX512_EQ(x, y) uint64_t(_mm512_cmpeq_epi8_mask(x, y))
+REFFUB_BYTE_KERNELS(avx512, "avx512f,avx512bw", 64, REFFUB_AVX512_LOAD,
+                    _mm512_set1_epi8, REFFUB_AVX512_EQ)
+
+#undef REFFUB_BYTE_KERNELS
+#undef REFFUB_SSE2_LOAD
+#undef REFFUB_SSE2_EQ
+#undef REFFUB_AVX2_LOAD
+#undef REFFUB_AVX2_EQ
+#undef REFFUB_AVX512_LOAD
+#undef REFFUB_AVX512_EQ
+#endif
+
+
+/**
+ * @brief      Gets the kernels of a tier. A tier which is not compiled in
+ *             falls back to the scalar kernels.
+ *
+ * @param[in]  tier  The tier.
+ *
+ * @return     The kernels.
+ */
+inline const byte_kernels& tier_kernels(cpu_tier tier) {
+    static constexpr byte_kernels scalar_kernels{
+        cpu_tier::scalar, scalar::find, scalar::count, scalar::rcount,
+        scalar::mismatch};
+#if defined(REFFUB_X86_DISPATCH)
+    static constexpr std::array<byte_kernels, 4> tiers{
+        scalar_kernels,
+        byte_kernels{cpu_tier::sse2, sse2::find, sse2::count, sse2::rcount,
+                     sse2::mismatch},
+        byte_kernels{cpu_tier::avx2, avx2::find, avx2::count, avx2::rcount,
+                     avx2::mismatch},
+        byte_kernels{cpu_tier::avx512, avx512::find, avx512::count,
+                     avx512::rcount, avx512::mismatch}};
+    return tiers[int(tier)];
+#else
+    return scalar_kernels;
+#endif
+}
+
+
+/**
+ * @brief      Checks if the CPU runs the given tier.
+ *
+ * @param[in]  tier  The tier.
+ *
+ * @return     True iff the tier is compiled in and supported.
+ */
+inline bool supported(cpu_tier tier) {
+#if defined(REFFUB_X86_DISPATCH)
+    __builtin_cpu_init();
+    switch (tier) {
+        case cpu_tier::scalar:
+        case cpu_tier::sse2: return true;
+        case cpu_tier::avx2: return __builtin_cpu_supports("avx2");
+        case cpu_tier::avx512:
+            return __builtin_cpu_supports("avx512f") &&
+                   __builtin_cpu_supports("avx512bw");
+    }
+    return false;
+#else
+    return tier == cpu_tier::scalar;
+#endif
+}
+
+
+/**
+ * @brief      Gets the widest tier the CPU runs.
+ *
+ * @return     The tier.
+ */
+inline cpu_tier best_tier() {
+    for (auto tier : {cpu_tier::avx512, cpu_tier::avx2, cpu_tier::sse2}) {
+        if (supported(tier)) { return tier; }
+    }
+    return cpu_tier::scalar;
+}
+
+
+/**
+ * @brief      The kernels in use, bound to the best tier at startup.
+ */
+inline std::atomic<const byte_kernels*> active_kernels{
+    &tier_kernels(best_tier())};
+
+
+/**
+ * @brief      Gets the kernels in use.
+ *
+ * @return     The kernels.
+ */
+inline const byte_kernels& active() {
+    return *active_kernels.load(std::memory_order_relaxed);
+}
+
+
+/**
+ * @brief      Binds the kernels of the given tier, e.g. to compare the tiers
+ *             in a benchmark. Kernel calls running meanwhile finish with the
+ *             tier they started with.
+ *
+ * @param[in]  tier  The tier.
+ *
+ * @return     False if the CPU does not run the tier, in which case nothing
+ *             changes.
+ */
+inline bool force_tier(cpu_tier tier) {
+    if (!supported(tier)) { return false; }
+    active_kernels.store(&tier_kernels(tier), std::memory_order_relaxed);
+    return true;
+}
+
+
+/**
+ * @brief      Checks the kernels of every supported tier against the scalar
+ *             ones on inputs of all lengths up to a few vectors and at all
+ *             alignments within a vector.
+ *
+ * @return     True iff all the kernels agree.
+ */
+inline bool self_check() {
+    std::array<char, 320> a{}, b{};
+    for (int64_t i = 0; i < int64_t(a.size()); ++i) {
+        a[i] = b[i] = "ab\n"[(i * i + i / 7) % 3];
+    }
+    const auto& reference = tier_kernels(cpu_tier::scalar);
+    for (auto tier : {cpu_tier::sse2, cpu_tier::avx2, cpu_tier::avx512}) {
+        if (!supported(tier)) { continue; }
+        const auto& k = tier_kernels(tier);
+        for (int64_t offset = 0; offset < 64; ++offset) {
+            for (int64_t n = 0; offset + n <= int64_t(a.size()); n += 7) {
+                const char* p = a.data() + offset;
+                for (char c : {'a', '\n', 'z'}) {
+                    if (k.find(p, n, c) != reference.find(p, n, c) ||
+                        k.count(p, n, c) != reference.count(p, n, c) ||
+                        k.rcount(p, n, c, 3) != reference.rcount(p, n, c, 3)) {
+                        return false;
+                    }
+                }
+                b[offset + n / 2] ^= n > 0;
+                bool same = k.mismatch(p, b.data() + offset, n) ==
+                            reference.mismatch(p, b.data() + offset, n);
+                b[offset + n / 2] ^= n > 0;
+                if (!same) { return false; }
+            }
+        }
+    }
+    return true;
+}
+
+
+}  // namespace kernels
+
+
+#undef REFFUB_X86_DISPATCH
@@ -0,0 +1,203 @@
+#pragma once
+
+
+#include <algorithm>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gap_buffer.hpp"
+#include "thread_pool.hpp"
+
+
+/**
+ * @brief      Describes an edit of a text, namely \p removed characters
+ *             starting at \p offset are replaced by \p inserted.
+ */
+struct text_edit {
+    int64_t offset{0};
+    int64_t removed{0};
+    std::string inserted{};
+};
+
+
+/**
+ * @brief      This class describes a strand serializing the edits of a
+ *             gap_buffer<char> coming from many coroutines, e.g. one per
+ *             client connection. `co_await strand.apply(edit)` queues the
+ *             edit and suspends the coroutine. A single task of the thread
+ *             pool drains the queue: all the edits queued so far are applied
+ *             as one batch (see gap_buffer::begin_batch()), so the observers
+ *             hear about them at once, and then the waiting coroutines are
+ *             resumed on that thread. Edits arriving while a batch is being
+ *             applied make up the next batch of the same task, so a busy
+ *             buffer costs one task, not one per edit.
+ *
+ *             An edit which throws (or whose observers throw) does not stop
+ *             the strand: the exception is rethrown by the `co_await` of
+ *             that edit, while the rest of the batch is applied as usual.
+ *
+ *             The buffer must only be touched through the strand and must
+ *             outlive it. The destructor waits until the strand is idle
+ *             (see wait_idle()), so the pool must still be running then.
+ */
+class edit_strand {
+  private:
+    struct queued_edit {
+        text_edit edit;
+        std::coroutine_handle<> waiter;
+        std::exception_ptr* error;
+    };
+
+    /**
+     * @brief      The awaitable returned by apply().
+     */
+    struct apply_awaiter {
+        edit_strand* strand;
+        text_edit edit;
+        std::exception_ptr error{};
+
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> waiter) {
+            strand->enqueue({std::move(edit), waiter, &error});
+        }
+
+        void await_resume() const {
+            if (error) { std::rethrow_exception(error); }
+        }
+    };
+
+  private:
+    gap_buffer<char>* _buf;
+    thread_pool* _pool;
+    std::mutex _mutex{};
+    std::vector<queued_edit> _queue{};
+    bool _draining{false};
+    std::condition_variable _idle{};
+
+
+  private:
+    /**
+     * @brief      Queues an edit and schedules the drain if it is not
+     *             running.
+     *
+     * @param[in]  queued  The edit and its waiter.
+     */
+    void enqueue(queued_edit queued) {
+        {
+            std::scoped_lock lock{_mutex};
+            _queue.push_back(std::move(queued));
+            if (std::exchange(_draining, true)) { return; }
+        }
+        _pool->submit([this] { drain(); });
+    }
+
+
+    /**
+     * @brief      Applies a batch of edits. The exception thrown by an edit is
+     *             handed to its waiter, the one thrown by the observers when
+     *             the batch ends to every waiter not failed yet.
+     *
+     * @param      batch  The edits.
+     */
+    void apply_batch(std::vector<queued_edit>& batch) {
+        _buf->begin_batch();
+        for (auto& [edit, waiter, error] : batch) {
+            try {
+                int64_t offset = std::clamp<int64_t>(edit.offset, 0,
+                                                     _buf->size());
+                if (edit.removed > 0) { _buf->remove(offset, edit.removed); }
+                _buf->insert(offset, std::string_view{edit.inserted});
+            } catch (...) {
+                *error = std::current_exception();
+            }
+        }
+        try {
+            _buf->end_batch();
+        } catch (...) {
+            for (auto& queued : batch) {
+                if (!*queued.error) {
+                    *queued.error = std::current_exception();
+                }
+            }
+        }
+    }
+
+
+    /**
+     * @brief      Applies the queued edits batch by batch until the queue
+     *             stays empty. Going idle is the last thing it does with the
+     *             strand, so wait_idle() may return only once it is done.
+     */
+    void drain() {
+        std::vector<queued_edit> batch;
+        while (true) {
+            batch.clear();
+            {
+                std::scoped_lock lock{_mutex};
+                if (_queue.empty()) {
+                    _draining = false;
+                    _idle.notify_all();
+                    return;
+                }
+                std::swap(batch, _queue);
+            }
+            apply_batch(batch);
+            for (auto& queued : batch) { queued.waiter.resume(); }
+        }
+    }
+
+
+  public:
+    /**
+     * @brief      Constructs a new instance of edit strand.
+     *
+     * @param      buf   The edited buffer.
+     * @param      pool  The pool applying the edits.
+     */
+    edit_strand(gap_buffer<char>& buf, thread_pool& pool)
+        : _buf{&buf}, _pool{&pool} {}
+
+
+    edit_strand(const edit_strand&) = delete;
+    edit_strand& operator=(const edit_strand&) = delete;
+
+
+    /**
+     * @brief      Waits until the strand is idle and destroys the object.
+     */
+    ~edit_strand() { wait_idle(); }
+
+
+  public:
+    /**
+     * @brief      Queues an edit. The returned object has to be awaited, the
+     *             awaiting coroutine is resumed once the edit is applied.
+     *
+     * @param[in]  edit  The edit.
+     *
+     * @return     The awaitable.
+     */
+    [[nodiscard]] apply_awaiter apply(text_edit edit) {
+        return {this, std::move(edit)};
+    }
+
+
+    /**
+     * @brief      Waits until all the queued edits are applied, their waiters
+     *             resumed and the drain is over, i.e. until the strand does
+     *             not touch the buffer nor itself anymore. It must not be
+     *             called by a resumed waiter, as those run on the drain
+     *             itself.
+     */
+    void wait_idle() {
+        std::unique_lock lock{_mutex};
+        _idle.wait(lock, [this] { return !_draining; });
+    }
+};
@@ -4,10 +4,21 @@
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <compare>
+#include <cstddef>
+#include <exception>
+#include <memory>
 #include <numeric>
+#include <optional>
 #include <ranges>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "kernels.hpp"
+
 
 /**
  * @brief      Gets the first type out of variadic templates.
@@ -103,6 +114,128 @@ inline constexpr auto concat(Vs&&... vs) {
 }
 
 
+/**
+ * @brief      Word, line and character statistics of a text. A word is a
+ *             maximal run of non-whitespace characters and lines are
+ *             separated by '\n', so an empty text has exactly one line.
+ */
+struct text_stats {
+    int64_t chars{0};
+    int64_t words{0};
+    int64_t lines{1};
+
+    constexpr bool operator==(const text_stats&) const = default;
+};
+
+
+/**
+ * @brief      Describes a single edit of a content, namely \p removed
+ *             elements starting at \p offset have been replaced by
+ *             \p inserted new ones.
+ */
+struct edit_range {
+    int64_t offset{0};
+    int64_t removed{0};
+    int64_t inserted{0};
+
+    constexpr bool operator==(const edit_range&) const = default;
+};
+
+
+/**
+ * @brief      Interface of the consumers which have to be told about every
+ *             edit of a gap buffer, see gap_buffer::subscribe(). The
+ *             notification is delivered once the content is already edited.
+ *             An observer must not edit the buffer it observes.
+ */
+class edit_observer {
+  public:
+    constexpr virtual ~edit_observer() = default;
+
+
+    /**
+     * @brief      Called after the observed content has been edited.
+     *
+     * @param[in]  offset    The content index at which the edit happened.
+     * @param[in]  removed   The number of removed elements.
+     * @param[in]  inserted  The number of inserted elements.
+     */
+    constexpr virtual void on_edit(int64_t offset, int64_t removed,
+                                   int64_t inserted) = 0;
+};
+
+
+/**
+ * @brief      Interface of the observers which refer to the buffer they
+ *             observe, e.g. the indexes over its content. The observers of a
+ *             buffer follow its content when it is moved to another object
+ *             (see the move constructor and swap() of gap_buffer), so these
+ *             have to be told where it lives now.
+ *
+ * @tparam     Buffer  The type of the observed buffer.
+ */
+template <typename Buffer>
+class buffer_observer : public edit_observer {
+  public:
+    /**
+     * @brief      Called after the observed content has been moved, together
+     *             with the subscription, to another buffer object. It runs
+     *             within the noexcept move constructor and swap() of the
+     *             buffer, so it must not throw.
+     *
+     * @param      buffer  The buffer now holding the content.
+     */
+    constexpr virtual void on_move(Buffer& buffer) noexcept = 0;
+};
+
+
+/**
+ * @brief      Base of the observers which keep an index over the content of
+ *             a buffer. It subscribes to the buffer for its whole lifetime,
+ *             so the index hears every edit, and follows the buffer to the
+ *             object its content is moved to. Derived classes reach the
+ *             buffer through \p _buf and only implement on_edit(). The
+ *             buffer has to outlive the subscription.
+ *
+ * @tparam     Buffer  The type of the observed buffer.
+ */
+template <typename Buffer>
+class buffer_subscription : public buffer_observer<Buffer> {
+  protected:
+    Buffer* _buf;
+
+
+  protected:
+    /**
+     * @brief      Constructs a new instance of buffer subscription.
+     *
+     * @param      buf   The observed buffer.
+     */
+    constexpr explicit buffer_subscription(Buffer& buf) : _buf{&buf} {
+        _buf->subscribe(*this);
+    }
+
+
+  public:
+    buffer_subscription(const buffer_subscription&) = delete;
+    buffer_subscription& operator=(const buffer_subscription&) = delete;
+
+
+    /**
+     * @brief      Unsubscribes from the buffer and destroys the object.
+     */
+    constexpr ~buffer_subscription() override { _buf->unsubscribe(*this); }
+
+
+    /**
+     * @brief      Follows the buffer to the object it has been moved to.
+     *
+     * @param      buf   The buffer now holding the content.
+     */
+    constexpr void on_move(Buffer& buf) noexcept final { _buf = &buf; }
+};
+
+
 /**
  * @brief      This class describes a gap buffer. Recall that the content of a
  *             gap buffer consists of everything inside the buffer
@@ -120,19 +253,221 @@ inline constexpr auto concat(Vs&&... vs) {
  *             and we insert element to the gap buffer then this element is
  *             pushed front (pushed back resp.).
  *
- * @tparam     T     The type held by the buffer.
+ *             The const member functions do not modify the object, so any
+ *             number of them may run concurrently, e.g. under a shared lock.
+ *             Everything else, including the line queries (line_start(),
+ *             line_end(), lines()) which extend the lazily built line index,
+ *             needs exclusive access.
+ *
+ *             The insertions and the reallocations give the strong exception
+ *             guarantee provided moving T does not throw: if an allocation
+ *             or a copy of an inserted element throws, the content, the
+ *             statistics and the line index are as before the call. The
+ *             other edits allocate, if at all, before touching the content,
+ *             and throw nothing else but what the observers and the passed
+ *             functions throw. If a function passed to modify(),
+ *             transform_range() or erase_if() throws, the edit stops where
+ *             it is, but the statistics, the line index and the observers
+ *             are brought in line with the content before the exception is
+ *             passed on. If moving T may throw, the edits which move the
+ *             gap give the basic guarantee only.
+ *
+ * @tparam     T          The type held by the buffer.
+ * @tparam     Allocator  The allocator of the internal buffer, e.g. a
+ *                        slab_allocator shared by many small buffers.
  */
-template <typename T>
+template <typename T, typename Allocator = std::allocator<T>>
 class gap_buffer {
   private:
-    using buf_t = std::vector<T>;
+    using buf_t = std::vector<T, Allocator>;
     static_assert(std::ranges::common_range<buf_t>);
     using buf_i = typename buf_t::iterator;
     using gap_t = std::ranges::subrange<buf_i>;
+    using alloc_traits = std::allocator_traits<Allocator>;
+
+    /**
+     * @brief      The lazily built line index (the starts of the lines
+     *             following the first one, found in the first \p scanned
+     *             elements) and the text statistics. They only mean anything
+     *             for text, so other buffers hold an empty_state instead,
+     *             which takes no room.
+     */
+    struct line_state {
+        std::vector<int64_t> starts{};
+        int64_t scanned{0};
+        text_stats stats{};
+    };
+
+    struct empty_state {};
+
+    using line_state_t =
+        std::conditional_t<std::same_as<T, char>, line_state, empty_state>;
+
+  public:
+    /**
+     * @brief      The gap size a copy gets by default, so that it does not
+     *             reallocate on the first small insertion.
+     */
+    static constexpr int64_t copy_gap = 64;
+
+
+    /**
+     * @brief      Random access iterator over the content. It holds a content
+     *             index rather than a position in the internal buffer, so it
+     *             survives the edits (as an index, it is not shifted by them)
+     *             and is resolved to the element in O(1) on every access.
+     *             Debug builds check that it is in range when dereferenced
+     *             and that compared iterators belong to the same buffer.
+     *             stale() tells whether the buffer has been edited since the
+     *             iterator was obtained. Debug builds also assert on the
+     *             dereference of an iterator whose buffer has had its whole
+     *             content replaced since (by an assignment, a swap or a move
+     *             out of it), as the index is then meaningless.
+     *
+     * @tparam     Const  Whether the elements are read-only.
+     */
+    template <bool Const>
+    class basic_iterator {
+      private:
+        template <bool>
+        friend class basic_iterator;
+        friend class gap_buffer;
+
+        using owner_t = std::conditional_t<Const, const gap_buffer, gap_buffer>;
+
+      private:
+        owner_t* _owner{nullptr};
+        int64_t _index{0};
+        int64_t _generation{0};
+        int64_t _epoch{0};
+
+
+        constexpr basic_iterator(owner_t* owner, int64_t index)
+            : _owner{owner}, _index{index}, _generation{owner->_generation},
+              _epoch{owner->_epoch} {}
+
+
+        constexpr void check_owner(const basic_iterator& other) const {
+            if !consteval { assert(_owner == other._owner); }
+        }
+
+
+      public:
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::conditional_t<Const, const T&, T&>;
+
+
+        constexpr basic_iterator() = default;
+
+
+        constexpr basic_iterator(const basic_iterator<!Const>& other)
+        requires(Const)
+            : _owner{other._owner}, _index{other._index},
+              _generation{other._generation}, _epoch{other._epoch} {}
+
+
+        /**
+         * @brief      Gets the content index the iterator points at.
+         *
+         * @return     The content index.
+         */
+        constexpr int64_t index() const { return _index; }
+
+
+        /**
+         * @brief      Checks if the buffer has been edited since the iterator
+         *             was obtained, i.e. if the index may refer to another
+         *             element than it used to.
+         *
+         * @return     True iff there has been an edit in the meantime.
+         */
+        constexpr bool stale() const {
+            return _generation != _owner->_generation;
+        }
+
+
+        constexpr reference operator*() const {
+            if !consteval {
+                assert(_epoch == _owner->_epoch);
+                assert(0 <= _index && _index < _owner->size());
+            }
+            return _owner->element(_index);
+        }
+
+        constexpr reference operator[](difference_type n) const {
+            return *(*this + n);
+        }
+
+        constexpr basic_iterator& operator++() { return *this += 1; }
+        constexpr basic_iterator& operator--() { return *this -= 1; }
+
+        constexpr basic_iterator operator++(int) {
+            auto old = *this;
+            ++*this;
+            return old;
+        }
+
+        constexpr basic_iterator operator--(int) {
+            auto old = *this;
+            --*this;
+            return old;
+        }
+
+        constexpr basic_iterator& operator+=(difference_type n) {
+            _index += n;
+            return *this;
+        }
+
+        constexpr basic_iterator& operator-=(difference_type n) {
+            _index -= n;
+            return *this;
+        }
+
+        constexpr basic_iterator operator+(difference_type n) const {
+            auto it = *this;
+            return it += n;
+        }
+
+        friend constexpr basic_iterator operator+(difference_type n,
+                                                  const basic_iterator& it) {
+            return it + n;
+        }
+
+        constexpr basic_iterator operator-(difference_type n) const {
+            auto it = *this;
+            return it -= n;
+        }
+
+        constexpr difference_type operator-(const basic_iterator& rhs) const {
+            check_owner(rhs);
+            return _index - rhs._index;
+        }
+
+        constexpr bool operator==(const basic_iterator& rhs) const {
+            check_owner(rhs);
+            return _index == rhs._index;
+        }
+
+        constexpr auto operator<=>(const basic_iterator& rhs) const {
+            check_owner(rhs);
+            return _index <=> rhs._index;
+        }
+    };
+
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
 
   private:
     buf_t _buf{};
     gap_t _gap{_buf};
+    [[no_unique_address]] line_state_t _lines{};
+    std::vector<edit_observer*> _observers{};
+    std::optional<edit_range> _pending{};
+    int64_t _batch_depth{0};
+    int64_t _generation{0};
+    // Bumped when the whole content is replaced, see basic_iterator.
+    int64_t _epoch{0};
 
 
   private:
@@ -141,7 +476,7 @@ class gap_buffer {
      *
      * @return     The current buffer size.
      */
-    constexpr int64_t buf_size() const { return _buf.size(); }
+    constexpr int64_t buf_size() const noexcept { return _buf.size(); }
 
 
     /**
@@ -149,7 +484,7 @@ class gap_buffer {
      *
      * @return     std::pair containing the beginning and the end of the gap.
      */
-    constexpr auto gap_id() const {
+    constexpr auto gap_id() const noexcept {
         auto [gb, ge] = _gap;
         return std::make_pair(gb - _buf.begin(), ge - _buf.begin());
     }
@@ -160,218 +495,1237 @@ class gap_buffer {
      *
      * @return     The gap size.
      */
-    constexpr int64_t gap_size() const { return _gap.size(); }
+    constexpr int64_t gap_size() const noexcept { return _gap.size(); }
 
 
-  private:
     /**
-     * @brief      Resizes the internal buffer. Doubling size strategy is
-     *             applied.
+     * @brief      Translates a content index into an index of the internal
+     *             buffer.
      *
-     * @param[in]  i     The size by which the buffer is to be extended. If
-     *                   negative, nothing happens.
+     * @param[in]  index  The content index belonging to [0, size()].
+     *
+     * @return     The buffer index.
      */
-    constexpr void enlarge_by_at_least(int64_t i) {
-        if (i <= 0) { return; }
-        int64_t old_buf_size = buf_size();
-        int64_t new_buf_size = 2 * std::max(i, old_buf_size);
-        auto [gb, ge] = gap_id();
-        _buf.resize(new_buf_size);
-        _gap = gap_t{_buf.begin() + gb, _buf.end() - (old_buf_size - ge)};
-        std::ranges::subrange old_right_data{_buf.begin() + ge,
-                                             _buf.begin() + old_buf_size};
-        std::ranges::copy_backward(old_right_data, _buf.end());
+    constexpr int64_t physical(int64_t index) const {
+        return index < gap_id().first ? index : index + gap_size();
     }
 
 
     /**
-     * @brief      Moves the cursor (the left end of the gap) to the right.
-     *             Note that some enlarging might happen.
+     * @brief      Gets the content element at the given index.
      *
-     * @param[in]  count  We assume that \p count >= 0. The number of positions
-     *                    by which the cursor is shifted right.
+     * @param[in]  index  The content index belonging to [0, size()).
+     *
+     * @return     A reference to the element.
      */
-    constexpr void move_cursor_right(int64_t count) {
-        [[assume(count >= 0)]];
-        auto [gb, ge] = gap_id();
-        enlarge_by_at_least(ge + count - buf_size());
-        gap_t new_gap{_buf.begin() + gb + count, _buf.begin() + ge + count};
-        std::ranges::copy(_gap.end(), new_gap.end(), _buf.begin() + gb);
-        _gap = new_gap;
-    }
+    constexpr T& element(int64_t index) { return _buf[physical(index)]; }
 
 
     /**
-     * @brief      Moves the cursor (the left end of the gap) left.
-     *             Note that some enlarging might happen.
+     * @brief      Gets the content element at the given index.
      *
-     * @param[in]  count  We assume that \p count >= 0. The number of positions
-     *                    by which the cursor is shifted left.
+     * @param[in]  index  The content index belonging to [0, size()).
+     *
+     * @return     A const reference to the element.
      */
-    constexpr void move_cursor_left(int64_t count) {
-        [[assume(count >= 0)]];
-        auto [gb, ge] = gap_id();
-        enlarge_by_at_least(count - gb);
-        gap_t new_gap{_buf.begin() + gb - count, _buf.begin() + ge - count};
-        std::ranges::copy_backward(
-            new_gap.begin(), _gap.begin(), _buf.begin() + ge);
-        _gap = new_gap;
+    constexpr const T& element(int64_t index) const {
+        return _buf[physical(index)];
     }
 
 
     /**
-     * @brief      Moves the cursor (the left end of the gap) to a given index.
+     * @brief      Splits the range [\p index, \p index + \p count) of the
+     *             content into the parts before and after the gap, see
+     *             segments().
      *
-     * @param[in]  index  The index to which cursor is moved.
+     * @param      data   The beginning of the internal buffer.
+     * @param[in]  index  The starting index of the range.
+     * @param[in]  count  The length of the range.
+     *
+     * @return     The segments before and after the gap.
      */
-    constexpr void move_cursor_to(int64_t index) {
+    template <typename U>
+    constexpr std::array<std::span<U>, 2> segments_of(U* data, int64_t index,
+                                                      int64_t count) const {
+        if !consteval { assert(0 <= index && 0 <= count); }
+        if !consteval { assert(index + count <= size()); }
         auto [gb, ge] = gap_id();
-        if (index == gb) return;
-        if (index > gb) {
-            move_cursor_right(index - gb);
-            return;
-        }
-        move_cursor_left(gb - index);
+        int64_t end = index + count;
+        int64_t lb = std::min(index, gb), le = std::min(end, gb);
+        int64_t rb = std::max(index, gb), re = std::max(end, gb);
+        return {std::span<U>{data + lb, size_t(le - lb)},
+                std::span<U>{data + rb + (ge - gb), size_t(re - rb)}};
     }
 
 
-  public:
     /**
-     * @brief      Constructs a new instance of gap buffer.
+     * @brief      Finds the first occurrence of a non-empty needle within a
+     *             segment. For word sized elements the candidates are found
+     *             by kernels::find() on the first element of the needle.
+     *
+     * @param[in]  seg     The segment.
+     * @param      needle  The searched sequence.
+     *
+     * @return     The index of the occurrence or -1 if there is none.
      */
-    constexpr gap_buffer() {}
+    template <typename V>
+    static constexpr int64_t search(std::span<const T> seg, V& needle) {
+        if constexpr (kernels::word_element<T>) {
+            int64_t m = std::ranges::size(needle);
+            const T& head = *std::ranges::begin(needle);
+            for (int64_t i = 0; int64_t(seg.size()) - i >= m; ++i) {
+                int64_t hit =
+                    kernels::find(seg.subspan(i, seg.size() - i - m + 1), head);
+                if (hit < 0) { return -1; }
+                i += hit;
+                if constexpr (std::ranges::contiguous_range<V>) {
+                    std::span<const T> rest{needle};
+                    if (kernels::mismatch(seg.subspan(i, m), rest) == m) {
+                        return i;
+                    }
+                } else if (std::ranges::equal(seg.subspan(i, m), needle)) {
+                    return i;
+                }
+            }
+            return -1;
+        } else {
+            auto hit = std::ranges::search(seg, needle);
+            return hit.empty() ? -1 : hit.begin() - seg.begin();
+        }
+    }
 
 
-  public:
     /**
-     * @brief      Provides a view over the content.
+     * @brief      Checks if a character separates words.
      *
-     * @return     The view over the content.
+     * @param[in]  c     The character.
+     *
+     * @return     True iff \p c is a whitespace character.
      */
-    constexpr auto view() {
-        auto [gb, ge] = gap_id();
-        return concat(std::ranges::subrange{_buf.begin(), _buf.begin() + gb},
-                      std::ranges::subrange{_buf.begin() + ge, _buf.end()});
+    static constexpr bool is_space(char c) {
+        return c == ' ' || ('\t' <= c && c <= '\r');
     }
 
 
     /**
-     * @brief      Provides the size of the content.
+     * @brief      Counts the words starting in the range [\p first, \p last).
+     *             The range is clamped to the content.
      *
-     * @return     The size of the content.
+     * @param[in]  first  The beginning of the range.
+     * @param[in]  last   The end of the range.
+     *
+     * @return     The number of words starting in the range.
      */
-    constexpr int64_t size() const { return _buf.size() - _gap.size(); }
+    constexpr int64_t count_word_starts(int64_t first, int64_t last) const
+    requires(std::same_as<T, char>) {
+        last = std::min(last, size());
+        if (first >= last) { return 0; }
+        bool after_space = first == 0 || is_space(element(first - 1));
+        int64_t count = 0;
+        for (auto seg : segments(first, last - first)) {
+            for (char c : seg) {
+                count += after_space && !is_space(c);
+                after_space = is_space(c);
+            }
+        }
+        return count;
+    }
 
 
     /**
-     * @brief      Checks if the content is empty.
+     * @brief      Counts the line separators in the given range.
      *
-     * @return     True iff there is no content.
+     * @param[in]  index  The beginning of the range.
+     * @param[in]  count  The length of the range.
+     *
+     * @return     The number of '\n' characters in the range.
      */
-    constexpr int64_t empty() const { return (size() == 0); }
+    constexpr int64_t count_newlines(int64_t index, int64_t count) const
+    requires(std::same_as<T, char>) {
+        int64_t newlines = 0;
+        for (auto seg : segments(index, count)) {
+            newlines += kernels::count(seg, '\n');
+        }
+        return newlines;
+    }
 
 
     /**
-     * @brief      Gets the last element of the content.
+     * @brief      Withdraws the part of the statistics which depends on the
+     *             range about to be removed. The word starting just after the
+     *             range is withdrawn too, as the edit might merge it with its
+     *             left neighbour. A pending batched edit which the upcoming
+     *             one cannot be merged with is delivered now, while the
+     *             content still matches it.
      *
-     * @return     A reference to the last element of the content.
+     * @param[in]  index    The content index at which the edit happens.
+     * @param[in]  removed  The number of elements to be removed.
      */
-    constexpr T& back() {
-        if (_gap.empty() || _gap.end() != _buf.end()) { return _buf.back(); }
-        return *(_gap.begin() - 1);
+    constexpr void before_edit(int64_t index, int64_t removed) {
+        if (_pending && (index > _pending->offset + _pending->inserted ||
+                         index + removed < _pending->offset)) {
+            flush_pending();
+        }
+        if constexpr (std::same_as<T, char>) {
+            auto& stats = _lines.stats;
+            stats.words -= count_word_starts(index, index + removed + 1);
+            stats.lines -= count_newlines(index, removed);
+        }
     }
 
 
     /**
-     * @brief       Gets the first element of the content.
+     * @brief      Updates the cached state after the content has changed.
+     *             Everything before \p index is assumed to be untouched.
+     *             Must be paired with a preceding before_edit() call. The
+     *             observers are notified here.
      *
-     * @return      A reference to the first element of the content.
+     * @param[in]  index     The content index at which the edit happened.
+     * @param[in]  removed   The number of removed elements.
+     * @param[in]  inserted  The number of inserted elements.
      */
-    constexpr T& front() {
-        if (_gap.empty() || _gap.begin() != _buf.begin()) {
-            return _buf.front();
+    constexpr void after_edit(int64_t index, int64_t removed,
+                              int64_t inserted) {
+        if constexpr (std::same_as<T, char>) {
+            auto& [starts, scanned, stats] = _lines;
+            scanned = std::min(scanned, index);
+            starts.erase(std::ranges::upper_bound(starts, scanned),
+                         starts.end());
+            stats.chars += inserted - removed;
+            stats.words += count_word_starts(index, index + inserted + 1);
+            stats.lines += count_newlines(index, inserted);
         }
-        return *(_gap.end());
+        ++_generation;
+        notify(index, removed, inserted);
     }
 
 
-  public:
     /**
-     * @brief      It is a procedure used to insert a view into the content at
-     *             the given position belonging to the range [0, size()]. E.g.
-     *             if \p index == 0 then the \p data is pushed front and if
-     *             \p index == size() then the \p data is pushed back.
-     *
-     * @tparam     V      A view contaning elements of type T.
-     *
-     * @param[in]  index  A position into which the \p data is inserted.
-     * @param[in]  data   Data to be inserted.
+     * @brief      Delivers an edit to the observers. In the batch mode the
+     *             edit is merged with the pending one instead. The two are
+     *             known to touch each other, see before_edit(), so their
+     *             union is a single edit of the content as it was before the
+     *             pending one.
      *
+     * @param[in]  index     The content index at which the edit happened.
+     * @param[in]  removed   The number of removed elements.
+     * @param[in]  inserted  The number of inserted elements.
      */
-    template <std::ranges::view V>
-    requires(std::same_as<std::ranges::range_value_t<V>, T>) &&
-            (std::ranges::sized_range<V>)
-    constexpr void insert(int64_t index, V data) {
-        if !consteval { assert(0 <= index && index <= size()); }
-        enlarge_by_at_least(data.size());
-        move_cursor_to(index);
-        auto [gb, ge] = gap_id();
-        std::ranges::copy(data, _buf.begin() + gb);
-        _gap = gap_t(_buf.begin() + gb + data.size(), _buf.begin() + ge);
+    constexpr void notify(int64_t index, int64_t removed, int64_t inserted) {
+        if (_observers.empty()) { return; }
+        if (_batch_depth == 0) {
+            deliver(index, removed, inserted);
+            return;
+        }
+        if (!_pending) {
+            _pending = edit_range{index, removed, inserted};
+            return;
+        }
+        auto [offset, pending_removed, pending_inserted] = *_pending;
+        int64_t lo = std::min(offset, index);
+        int64_t hi = std::max(offset + pending_inserted, index + removed);
+        _pending = edit_range{lo, hi - lo - pending_inserted + pending_removed,
+                              hi - lo - removed + inserted};
     }
 
 
     /**
-     * @brief      Inserts element at the given position.
+     * @brief      Delivers an edit to every observer. An observer which
+     *             throws does not keep the edit from the following ones, the
+     *             first exception is passed on once all have been called.
      *
-     * @param[in]  index  A position into which the \p t is inserted.
-     * @param[in]  t      An element to be inserted.
+     * @param[in]  offset    The content index at which the edit happened.
+     * @param[in]  removed   The number of removed elements.
+     * @param[in]  inserted  The number of inserted elements.
      */
-    constexpr void insert(int64_t index, T t) {
-        insert(index, std::views::single(t));
+    constexpr void deliver(int64_t offset, int64_t removed, int64_t inserted) {
+        if consteval {
+            for (auto* o : _observers) {
+                o->on_edit(offset, removed, inserted);
+            }
+            return;
+        }
+        std::exception_ptr error{};
+        for (auto* o : _observers) {
+            try {
+                o->on_edit(offset, removed, inserted);
+            } catch (...) {
+                if (!error) { error = std::current_exception(); }
+            }
+        }
+        if (error) { std::rethrow_exception(error); }
     }
 
 
     /**
-     * @brief      Inserts the data of view type at the cursor position.
-     *
-     * @param[in]  data  Data to be inserted.
+     * @brief      Delivers the pending batched edit, if any, to the observers.
      */
-    constexpr void insert(std::ranges::view auto data) {
-        insert(gap_id().first, data);
+    constexpr void flush_pending() {
+        if (!_pending) { return; }
+        auto [offset, removed, inserted] = *std::exchange(_pending, {});
+        deliver(offset, removed, inserted);
     }
 
 
     /**
-     * @brief      Inserts an element of type T at the cursor position.
+     * @brief      Extends the line index by the next line start found after
+     *             the already scanned part of the content. The index holds
+     *             the starts of the lines following the first one, so an
+     *             empty index is valid and costs no allocation.
      *
-     * @param[in]  t     An element to be inserted.
+     * @return     True iff a new line start was found.
      */
-    constexpr void insert(T t) { insert(gap_id().first, t); }
+    constexpr bool scan_next_line() requires(std::same_as<T, char>) {
+        for (auto seg : segments(_lines.scanned, size() - _lines.scanned)) {
+            auto it = std::ranges::find(seg, '\n');
+            _lines.scanned += it - seg.begin();
+            if (it != seg.end()) {
+                _lines.starts.push_back(++_lines.scanned);
+                return true;
+            }
+        }
+        return false;
+    }
 
 
+  private:
     /**
-     * @brief      Pushes a view of data at the front of the content.
+     * @brief      Copies the content of a buffer into a new internal buffer,
+     *             leaving a gap of the given size at the same content index
+     *             as in the copied buffer. The spare capacity of the copied
+     *             buffer is not carried over.
      *
-     * @param[in]  data     Data to be inserted.
+     * @param[in]  other  The copied buffer.
+     * @param[in]  gap    The gap size.
+     * @param[in]  alloc  The allocator of the new buffer.
+     *
+     * @return     The new internal buffer.
      */
-    constexpr void push_front(std::ranges::view auto data) { insert(0, data); }
+    static constexpr buf_t copy_buf(const gap_buffer& other, int64_t gap,
+                                    const Allocator& alloc) {
+        if !consteval { assert(gap >= 0); }
+        auto [left, right] = other.segments();
+        buf_t buf(alloc);
+        buf.reserve(other.size() + gap);
+        buf.insert(buf.end(), left.begin(), left.end());
+        buf.resize(left.size() + gap);
+        buf.insert(buf.end(), right.begin(), right.end());
+        return buf;
+    }
 
 
     /**
-     * @brief      Pushes an element at the front of the content.
+     * @brief      Takes over the content state of a buffer whose internal
+     *             buffer has just been moved into this one, given the gap it
+     *             had. The gap is restored from the indexes, as iterators
+     *             into a moved vector are not to be relied upon. The other
+     *             buffer is left empty, with its iterators stale. The
+     *             observers are not touched.
      *
-     * @param[in]  t     Element to be inserted.
+     * @param      other  The moved buffer.
+     * @param[in]  gap    The indexes of the gap of \p other before the move.
      */
-    constexpr void push_front(T t) { insert(0, t); }
+    constexpr void take(gap_buffer& other,
+                        std::pair<int64_t, int64_t> gap) noexcept {
+        _gap = gap_t{_buf.begin() + gap.first, _buf.begin() + gap.second};
+        _lines = std::exchange(other._lines, {});
+        other._buf.clear();
+        other._gap = gap_t{other._buf};
+        ++other._generation, ++other._epoch;
+    }
 
 
     /**
-     * @brief      Pushes a view of data at the end of the content.
-     *
-     * @param[in]  data  Data to be inserted.
+     * @brief      Tells the observers referring to the buffer (see
+     *             buffer_observer) that it now lives in this object.
      */
-    constexpr void push_back(std::ranges::view auto data) {
+    constexpr void rebind_observers() noexcept {
+        for (auto* o : _observers) {
+            if (auto* b = dynamic_cast<buffer_observer<gap_buffer>*>(o)) {
+                b->on_move(*this);
+            }
+        }
+    }
+
+
+    /**
+     * @brief      Resizes the internal buffer. Doubling size strategy is
+     *             applied. The content is relocated into a new buffer which
+     *             replaces the old one only once it is complete, so a
+     *             throwing allocation or copy leaves the object untouched.
+     *             Like the cursor moves below, it moves the elements rather
+     *             than copying them, so buffers of heavy elements (e.g. other
+     *             buffers) are cheap to edit, unless their move or default
+     *             construction (of the new gap) may throw. The old buffer is
+     *             then left intact until the swap.
+     *
+     * @param[in]  i     The size by which the buffer is to be extended. If
+     *                   negative, nothing happens.
+     */
+    constexpr void enlarge_by_at_least(int64_t i) {
+        if (i <= 0) { return; }
+        int64_t old_buf_size = buf_size();
+        int64_t new_buf_size = 2 * std::max(i, old_buf_size);
+        auto [gb, ge] = gap_id();
+        buf_t grown(_buf.get_allocator());
+        grown.reserve(new_buf_size);
+        auto relocate = [&](int64_t first, int64_t last) {
+            auto from = _buf.begin() + first, to = _buf.begin() + last;
+            if constexpr (std::is_nothrow_move_constructible_v<T> &&
+                          std::is_nothrow_default_constructible_v<T>) {
+                grown.insert(grown.end(), std::make_move_iterator(from),
+                             std::make_move_iterator(to));
+            } else {
+                grown.insert(grown.end(), from, to);
+            }
+        };
+        relocate(0, gb);
+        grown.resize(new_buf_size - (old_buf_size - ge));
+        relocate(ge, old_buf_size);
+        _buf.swap(grown);
+        _gap = gap_t{_buf.begin() + gb, _buf.end() - (old_buf_size - ge)};
+    }
+
+
+    /**
+     * @brief      Moves the cursor (the left end of the gap) to the right.
+     *             Note that some enlarging might happen.
+     *
+     * @param[in]  count  We assume that \p count >= 0. The number of positions
+     *                    by which the cursor is shifted right.
+     */
+    constexpr void move_cursor_right(int64_t count) {
+        [[assume(count >= 0)]];
+        auto [gb, ge] = gap_id();
+        enlarge_by_at_least(ge + count - buf_size());
+        gap_t new_gap{_buf.begin() + gb + count, _buf.begin() + ge + count};
+        std::ranges::move(_gap.end(), new_gap.end(), _buf.begin() + gb);
+        _gap = new_gap;
+    }
+
+
+    /**
+     * @brief      Moves the cursor (the left end of the gap) left.
+     *             Note that some enlarging might happen.
+     *
+     * @param[in]  count  We assume that \p count >= 0. The number of positions
+     *                    by which the cursor is shifted left.
+     */
+    constexpr void move_cursor_left(int64_t count) {
+        [[assume(count >= 0)]];
+        auto [gb, ge] = gap_id();
+        enlarge_by_at_least(count - gb);
+        gap_t new_gap{_buf.begin() + gb - count, _buf.begin() + ge - count};
+        std::ranges::move_backward(
+            new_gap.begin(), _gap.begin(), _buf.begin() + ge);
+        _gap = new_gap;
+    }
+
+
+    /**
+     * @brief      Moves the cursor (the left end of the gap) to a given index.
+     *
+     * @param[in]  index  The index to which cursor is moved.
+     */
+    constexpr void move_cursor_to(int64_t index) {
+        auto [gb, ge] = gap_id();
+        if (index == gb) return;
+        if (index > gb) {
+            move_cursor_right(index - gb);
+            return;
+        }
+        move_cursor_left(gb - index);
+    }
+
+
+    /**
+     * @brief      Prepares an insertion, i.e. makes the gap at least \p count
+     *             long and moves it to \p index. The inserted elements are
+     *             then to be written to the beginning of the gap and
+     *             committed by close_gap(). Until then the content is
+     *             unchanged, so an insertion whose elements fail to be
+     *             written is simply not committed.
+     *
+     * @param[in]  index  A position into which the elements are inserted.
+     * @param[in]  count  The number of inserted elements.
+     *
+     * @return     The iterator to the beginning of the gap.
+     */
+    constexpr buf_i open_gap(int64_t index, int64_t count) {
+        if !consteval { assert(0 <= index && index <= size()); }
+        enlarge_by_at_least(count - gap_size());
+        move_cursor_to(index);
+        return _gap.begin();
+    }
+
+
+    /**
+     * @brief      Commits an insertion prepared by open_gap().
+     *
+     * @param[in]  index  A position into which the elements were inserted.
+     * @param[in]  count  The number of inserted elements.
+     */
+    constexpr void close_gap(int64_t index, int64_t count) {
+        before_edit(index, 0);
+        _gap.advance(count);
+        after_edit(index, 0, count);
+    }
+
+
+  public:
+    /**
+     * @brief      Constructs a new instance of gap buffer.
+     */
+    constexpr gap_buffer() noexcept(noexcept(Allocator())) {}
+
+
+    /**
+     * @brief      Constructs a new instance of gap buffer which allocates with
+     *             the given allocator.
+     *
+     * @param[in]  alloc  The allocator.
+     */
+    constexpr explicit gap_buffer(const Allocator& alloc) : _buf(alloc) {}
+
+
+    /**
+     * @brief      Constructs a copy of a buffer holding its content and a gap
+     *             of the given size at its cursor. The line index and the
+     *             statistics are copied too, the observers are not.
+     *
+     * @param[in]  other  The copied buffer.
+     * @param[in]  gap    The gap size of the copy, nonnegative.
+     */
+    constexpr gap_buffer(const gap_buffer& other, int64_t gap)
+        : _buf{copy_buf(other, gap,
+                        alloc_traits::select_on_container_copy_construction(
+                            other._buf.get_allocator()))},
+          _gap{_buf.begin() + other.gap_id().first,
+               _buf.begin() + other.gap_id().first + gap},
+          _lines{other._lines} {}
+
+
+    /**
+     * @brief      Constructs a copy of a buffer with a gap of copy_gap
+     *             elements, see above.
+     *
+     * @param[in]  other  The copied buffer.
+     */
+    constexpr gap_buffer(const gap_buffer& other)
+        : gap_buffer(other, copy_gap) {}
+
+
+    /**
+     * @brief      Constructs a buffer by taking over the content, the line
+     *             index, the statistics and the observers of another one in
+     *             O(1). The observers follow the content, the ones referring
+     *             to the buffer are rebound to this object (see
+     *             buffer_observer), so e.g. an index survives the
+     *             reallocation of a std::vector of buffers. An open batch
+     *             and its pending edit move along with the observers, so no
+     *             edit is delivered and only buffer_observer::on_move(),
+     *             which does not throw, is called. The other buffer is left
+     *             empty and its iterators stale.
+     *
+     * @param      other  The moved buffer.
+     */
+    constexpr gap_buffer(gap_buffer&& other) noexcept
+        : _buf(other._buf.get_allocator()) {
+        auto gap = other.gap_id();
+        _buf.swap(other._buf);
+        take(other, gap);
+        _observers = std::move(other._observers);
+        other._observers.clear();
+        _pending = std::exchange(other._pending, {});
+        _batch_depth = std::exchange(other._batch_depth, 0);
+        rebind_observers();
+    }
+
+
+    /**
+     * @brief      Replaces the content by a copy of the content of another
+     *             buffer, with a gap of copy_gap elements. The observers of
+     *             this buffer are notified as of a single edit. If the copy
+     *             throws, nothing changes.
+     *
+     * @param[in]  other  The copied buffer.
+     *
+     * @return     This buffer.
+     */
+    constexpr gap_buffer& operator=(const gap_buffer& other) {
+        if (this == &other) { return *this; }
+        auto alloc = _buf.get_allocator();
+        if constexpr (alloc_traits::propagate_on_container_copy_assignment::
+                          value) {
+            alloc = other._buf.get_allocator();
+        }
+        buf_t buf = copy_buf(other, copy_gap, alloc);
+        int64_t removed = size();
+        before_edit(0, removed);
+        _buf = std::move(buf);
+        int64_t gb = other.gap_id().first;
+        _gap = gap_t{_buf.begin() + gb, _buf.begin() + gb + copy_gap};
+        ++_epoch;
+        after_edit(0, removed, size());
+        return *this;
+    }
+
+
+    /**
+     * @brief      Moves the content, the line index and the statistics of
+     *             another buffer into this one. Unlike with the move
+     *             constructor, both buffers keep their observers: the ones of
+     *             this buffer hear the content replaced and the ones of the
+     *             other buffer hear it emptied, each as a single edit. It is
+     *             O(1), plus what the observers do, unless the allocators
+     *             differ and do not propagate. As the observers are called,
+     *             it throws what they throw.
+     *
+     * @param      other  The moved buffer.
+     *
+     * @return     This buffer.
+     */
+    constexpr gap_buffer& operator=(gap_buffer&& other) {
+        if (this == &other) { return *this; }
+        auto gap = other.gap_id();
+        int64_t removed = size(), inserted = other.size();
+        _buf = std::move(other._buf);
+        take(other, gap);
+        ++_generation, ++_epoch;
+        notify(0, removed, inserted);
+        other.notify(0, inserted, 0);
+        return *this;
+    }
+
+
+    /**
+     * @brief      Exchanges the content, the line index, the statistics and
+     *             the observers with another buffer in O(1), plus the
+     *             rebinding of the observers as in the move constructor. The
+     *             open batches and their pending edits are exchanged too, so
+     *             no edit is delivered. As for std::vector, the allocators
+     *             have to compare equal unless they propagate on swap.
+     *
+     * @param      other  The other buffer.
+     */
+    constexpr void swap(gap_buffer& other) noexcept {
+        auto gap = gap_id(), other_gap = other.gap_id();
+        _buf.swap(other._buf);
+        _gap = gap_t{_buf.begin() + other_gap.first,
+                     _buf.begin() + other_gap.second};
+        other._gap = gap_t{other._buf.begin() + gap.first,
+                           other._buf.begin() + gap.second};
+        std::ranges::swap(_lines, other._lines);
+        std::ranges::swap(_observers, other._observers);
+        std::ranges::swap(_pending, other._pending);
+        std::ranges::swap(_batch_depth, other._batch_depth);
+        ++_generation, ++other._generation;
+        ++_epoch, ++other._epoch;
+        rebind_observers();
+        other.rebind_observers();
+    }
+
+
+    /**
+     * @brief      Exchanges two buffers, see swap().
+     *
+     * @param      a     The first buffer.
+     * @param      b     The second buffer.
+     */
+    friend constexpr void swap(gap_buffer& a, gap_buffer& b) noexcept {
+        a.swap(b);
+    }
+
+
+  public:
+    /**
+     * @brief      Registers an observer which is notified about every
+     *             subsequent edit. The observer has to outlive its
+     *             subscription.
+     *
+     * @param      observer  The observer.
+     */
+    constexpr void subscribe(edit_observer& observer) {
+        flush_pending();
+        _observers.push_back(&observer);
+    }
+
+
+    /**
+     * @brief      Unregisters an observer. A pending batched edit is not
+     *             delivered to it, so no observer is called.
+     *
+     * @param      observer  The observer.
+     */
+    constexpr void unsubscribe(edit_observer& observer) {
+        std::erase(_observers, &observer);
+    }
+
+
+    /**
+     * @brief      Starts the batch mode. Until the matching end_batch() call,
+     *             adjacent or overlapping edits are coalesced into one
+     *             notification, which is delivered as soon as an edit
+     *             elsewhere happens or the batch ends. Batches might be
+     *             nested.
+     */
+    constexpr void begin_batch() noexcept { ++_batch_depth; }
+
+
+    /**
+     * @brief      Ends the batch mode started by begin_batch().
+     */
+    constexpr void end_batch() {
+        if !consteval { assert(_batch_depth > 0); }
+        if (--_batch_depth == 0) { flush_pending(); }
+    }
+
+
+  public:
+    /**
+     * @brief      Provides a view over the content.
+     *
+     * @return     The view over the content.
+     */
+    constexpr auto view() {
+        auto [gb, ge] = gap_id();
+        return concat(std::ranges::subrange{_buf.begin(), _buf.begin() + gb},
+                      std::ranges::subrange{_buf.begin() + ge, _buf.end()});
+    }
+
+
+    /**
+     * @brief      Provides a read-only view over the content.
+     *
+     * @return     The view over the content.
+     */
+    constexpr auto view() const {
+        auto [gb, ge] = gap_id();
+        return concat(std::ranges::subrange{_buf.begin(), _buf.begin() + gb},
+                      std::ranges::subrange{_buf.begin() + ge, _buf.end()});
+    }
+
+
+    /**
+     * @brief      Gets an iterator to the beginning of the content, see
+     *             basic_iterator.
+     *
+     * @return     The iterator.
+     */
+    constexpr iterator begin() noexcept { return {this, 0}; }
+
+
+    /**
+     * @brief      Gets an iterator to the end of the content, see
+     *             basic_iterator.
+     *
+     * @return     The iterator.
+     */
+    constexpr iterator end() noexcept { return {this, size()}; }
+
+
+    /**
+     * @brief      Gets a read-only iterator to the beginning of the content.
+     *
+     * @return     The iterator.
+     */
+    constexpr const_iterator begin() const noexcept { return {this, 0}; }
+
+
+    /**
+     * @brief      Gets a read-only iterator to the end of the content.
+     *
+     * @return     The iterator.
+     */
+    constexpr const_iterator end() const noexcept { return {this, size()}; }
+
+
+    /**
+     * @brief      Provides the size of the content.
+     *
+     * @return     The size of the content.
+     */
+    constexpr int64_t size() const noexcept {
+        return _buf.size() - _gap.size();
+    }
+
+
+    /**
+     * @brief      Checks if the content is empty.
+     *
+     * @return     True iff there is no content.
+     */
+    constexpr int64_t empty() const noexcept { return (size() == 0); }
+
+
+    /**
+     * @brief      Gets the last element of the content.
+     *
+     * @return     A reference to the last element of the content.
+     */
+    constexpr T& back() {
+        if (_gap.empty() || _gap.end() != _buf.end()) { return _buf.back(); }
+        return *(_gap.begin() - 1);
+    }
+
+
+    /**
+     * @brief      Gets the last element of the content.
+     *
+     * @return     A const reference to the last element of the content.
+     */
+    constexpr const T& back() const { return element(size() - 1); }
+
+
+    /**
+     * @brief       Gets the first element of the content.
+     *
+     * @return      A reference to the first element of the content.
+     */
+    constexpr T& front() {
+        if (_gap.empty() || _gap.begin() != _buf.begin()) {
+            return _buf.front();
+        }
+        return *(_gap.end());
+    }
+
+
+    /**
+     * @brief       Gets the first element of the content.
+     *
+     * @return      A const reference to the first element of the content.
+     */
+    constexpr const T& front() const { return element(0); }
+
+
+    /**
+     * @brief      Provides the content in the range [\p index, \p index +
+     *             \p count) as at most two contiguous segments, namely the
+     *             parts lying before and after the gap. Either of them might
+     *             be empty.
+     *
+     * @param[in]  index  The starting index of the range.
+     * @param[in]  count  The length of the range.
+     *
+     * @return     The segments before and after the gap.
+     */
+    constexpr std::array<std::span<T>, 2> segments(int64_t index,
+                                                   int64_t count) {
+        return segments_of(_buf.data(), index, count);
+    }
+
+
+    /**
+     * @brief      Provides the content in the range [\p index, \p index +
+     *             \p count) as at most two read-only contiguous segments.
+     *
+     * @param[in]  index  The starting index of the range.
+     * @param[in]  count  The length of the range.
+     *
+     * @return     The segments before and after the gap.
+     */
+    constexpr std::array<std::span<const T>, 2> segments(int64_t index,
+                                                         int64_t count) const {
+        return segments_of(_buf.data(), index, count);
+    }
+
+
+    /**
+     * @brief      Provides the whole content as at most two contiguous
+     *             segments.
+     *
+     * @return     The segments before and after the gap.
+     */
+    constexpr std::array<std::span<T>, 2> segments() noexcept {
+        return segments(0, size());
+    }
+
+
+    /**
+     * @brief      Provides the whole content as at most two read-only
+     *             contiguous segments.
+     *
+     * @return     The segments before and after the gap.
+     */
+    constexpr std::array<std::span<const T>, 2> segments() const noexcept {
+        return segments(0, size());
+    }
+
+
+    /**
+     * @brief      Provides the content in the range [\p index, \p index +
+     *             \p count) as segments ordered from the back, namely the part
+     *             after the gap first, for scanning backwards. Each segment
+     *             is meant to be walked from its end.
+     *
+     * @param[in]  index  The starting index of the range.
+     * @param[in]  count  The length of the range.
+     *
+     * @return     The segments after and before the gap.
+     */
+    constexpr std::array<std::span<T>, 2> rsegments(int64_t index,
+                                                    int64_t count) {
+        auto [left, right] = segments(index, count);
+        return {right, left};
+    }
+
+
+    /**
+     * @brief      Provides the range [\p index, \p index + \p count) as
+     *             read-only segments ordered from the back.
+     *
+     * @param[in]  index  The starting index of the range.
+     * @param[in]  count  The length of the range.
+     *
+     * @return     The segments after and before the gap.
+     */
+    constexpr std::array<std::span<const T>, 2> rsegments(
+        int64_t index, int64_t count) const {
+        auto [left, right] = segments(index, count);
+        return {right, left};
+    }
+
+
+    /**
+     * @brief      Provides the whole content as segments ordered from the
+     *             back.
+     *
+     * @return     The segments after and before the gap.
+     */
+    constexpr std::array<std::span<T>, 2> rsegments() noexcept {
+        return rsegments(0, size());
+    }
+
+
+    /**
+     * @brief      Provides the whole content as read-only segments ordered
+     *             from the back.
+     *
+     * @return     The segments after and before the gap.
+     */
+    constexpr std::array<std::span<const T>, 2> rsegments() const noexcept {
+        return rsegments(0, size());
+    }
+
+
+    /**
+     * @brief      Provides the word, line and character statistics. They are
+     *             maintained incrementally by every edit, so this is O(1).
+     *
+     * @return     The statistics of the content.
+     */
+    constexpr const text_stats& stats() const noexcept
+    requires(std::same_as<T, char>) {
+        return _lines.stats;
+    }
+
+
+    /**
+     * @brief      Computes the statistics from scratch by scanning the whole
+     *             content. Meant for verifying the incrementally maintained
+     *             ones, see stats().
+     *
+     * @return     The statistics of the content.
+     */
+    constexpr text_stats recount_stats() const
+    requires(std::same_as<T, char>) {
+        return {size(), count_word_starts(0, size()),
+                count_newlines(0, size()) + 1};
+    }
+
+
+    /**
+     * @brief      Gets the number of lines. Lines are separated by '\n', so
+     *             there is always at least one (possibly empty) line.
+     *
+     * @return     The number of lines.
+     */
+    constexpr int64_t line_count() const requires(std::same_as<T, char>) {
+        return _lines.stats.lines;
+    }
+
+
+    /**
+     * @brief      Gets the content index at which the given line starts. The
+     *             line index is built lazily and edits only invalidate the
+     *             part of it lying after the edited position.
+     *
+     * @param[in]  line  The line number belonging to [0, line_count()).
+     *
+     * @return     The index of the first element of the line.
+     */
+    constexpr int64_t line_start(int64_t line) requires(std::same_as<T, char>) {
+        while (line > int64_t(_lines.starts.size()) && scan_next_line()) {}
+        if !consteval { assert(0 <= line && line < line_count()); }
+        return line == 0 ? 0 : _lines.starts[line - 1];
+    }
+
+
+    /**
+     * @brief      Gets the content index just past the given line, i.e. the
+     *             index of its terminating '\n' or size() for the last line.
+     *
+     * @param[in]  line  The line number belonging to [0, line_count()).
+     *
+     * @return     The index past the last element of the line.
+     */
+    constexpr int64_t line_end(int64_t line) requires(std::same_as<T, char>) {
+        line_start(line);
+        if (line < int64_t(_lines.starts.size()) || scan_next_line()) {
+            return _lines.starts[line] - 1;
+        }
+        return size();
+    }
+
+
+    /**
+     * @brief      Provides a lazy view over the lines [\p first, \p last),
+     *             meant for rendering a viewport. Every line is yielded as a
+     *             std::string_view (without the '\n') pointing directly into
+     *             the buffer. If the gap splits one of the lines, it is moved
+     *             to the nearer end of the range first, so no line is ever
+     *             copied. The view is invalidated by any edit.
+     *
+     * @param[in]  first  The first line of the range.
+     * @param[in]  last   The line past the range. It is clamped to
+     *                    line_count().
+     *
+     * @return     The view over the lines.
+     */
+    constexpr auto lines(int64_t first, int64_t last)
+    requires(std::same_as<T, char>) {
+        last = std::min(last, line_count());
+        first = std::clamp<int64_t>(first, 0, last);
+        if (first < last) {
+            int64_t begin = line_start(first), end = line_end(last - 1);
+            int64_t gb = gap_id().first;
+            if (begin < gb && gb < end) {
+                move_cursor_to(gb - begin < end - gb ? begin : end);
+            }
+        }
+        return std::views::iota(first, last) |
+               std::views::transform([this](int64_t line) {
+                   int64_t begin = line_start(line);
+                   return std::string_view{_buf.data() + physical(begin),
+                                           size_t(line_end(line) - begin)};
+               });
+    }
+
+
+    /**
+     * @brief      Finds the first occurrence of \p needle lying entirely
+     *             within the content range [\p from, \p to). Both segments
+     *             are searched directly and only the occurrences straddling
+     *             the gap are compared element by element.
+     *
+     * @tparam     V       A view containing elements of type T.
+     *
+     * @param[in]  needle  The searched sequence.
+     * @param[in]  from    The beginning of the searched range.
+     * @param[in]  to      The end of the searched range.
+     *
+     * @return     The index of the occurrence, if any.
+     */
+    template <std::ranges::view V>
+    requires(std::same_as<std::ranges::range_value_t<V>, T>) &&
+            (std::ranges::sized_range<V>)
+    constexpr std::optional<int64_t> find(V needle, int64_t from,
+                                          int64_t to) const {
+        int64_t m = std::ranges::size(needle);
+        if (m == 0) { return from; }
+        if (to - from < m) { return std::nullopt; }
+        auto [left, right] = segments(from, to - from);
+        if (int64_t hit = search(left, needle); hit >= 0) {
+            return from + hit;
+        }
+        int64_t split = from + left.size();
+        for (int64_t i = std::max(from, split - m + 1);
+             i < split && i + m <= to; ++i) {
+            auto it = std::ranges::begin(needle);
+            int64_t j = 0;
+            while (j < m && element(i + j) == *it) { ++j, ++it; }
+            if (j == m) { return i; }
+        }
+        if (int64_t hit = search(right, needle); hit >= 0) {
+            return split + hit;
+        }
+        return std::nullopt;
+    }
+
+
+    /**
+     * @brief      Finds the first occurrence of \p needle starting at or
+     *             after \p from.
+     *
+     * @param[in]  needle  The searched sequence.
+     * @param[in]  from    The index the search starts at.
+     *
+     * @return     The index of the occurrence, if any.
+     */
+    constexpr std::optional<int64_t> find(std::ranges::view auto needle,
+                                          int64_t from = 0) const {
+        return find(needle, from, size());
+    }
+
+
+    /**
+     * @brief      Finds the \p n-th occurrence of \p value scanning backwards
+     *             from \p to, across the gap. E.g. rfind('\n', pos, 3) + 1 is
+     *             the start of the line three lines above the one of pos.
+     *             Word sized elements are scanned by kernels::rcount().
+     *
+     * @param[in]  value  The searched element.
+     * @param[in]  to     The end of the scanned range [0, \p to).
+     * @param[in]  n      The number of occurrences to be skipped over,
+     *                    counting the searched one.
+     *
+     * @return     The index of the occurrence, if any.
+     */
+    constexpr std::optional<int64_t> rfind(const T& value, int64_t to,
+                                           int64_t n = 1) const {
+        to = std::clamp<int64_t>(to, 0, size());
+        if (n <= 0) { return std::nullopt; }
+        int64_t end = to;
+        for (auto seg : rsegments(0, to)) {
+            int64_t begin = end - seg.size();
+            if constexpr (kernels::word_element<T>) {
+                auto [count, last] = kernels::rcount(seg, value, n);
+                if (count == n) { return begin + last; }
+                n -= count;
+            } else {
+                for (int64_t i = seg.size() - 1; i >= 0; --i) {
+                    if (seg[i] == value && --n == 0) { return begin + i; }
+                }
+            }
+            end = begin;
+        }
+        return std::nullopt;
+    }
+
+
+  public:
+    /**
+     * @brief      It is a procedure used to insert a view into the content at
+     *             the given position belonging to the range [0, size()]. E.g.
+     *             if \p index == 0 then the \p data is pushed front and if
+     *             \p index == size() then the \p data is pushed back.
+     *
+     * @tparam     V      A view contaning elements of type T.
+     *
+     * @param[in]  index  A position into which the \p data is inserted.
+     * @param[in]  data   Data to be inserted.
+     *
+     */
+    template <std::ranges::view V>
+    requires(std::same_as<std::ranges::range_value_t<V>, T>) &&
+            (std::ranges::sized_range<V>)
+    constexpr void insert(int64_t index, V data) {
+        std::ranges::copy(data, open_gap(index, data.size()));
+        close_gap(index, data.size());
+    }
+
+
+    /**
+     * @brief      Inserts element at the given position.
+     *
+     * @param[in]  index  A position into which the \p t is inserted.
+     * @param[in]  t      An element to be inserted.
+     */
+    constexpr void insert(int64_t index, T t) {
+        insert(index, std::views::single(t));
+    }
+
+
+    /**
+     * @brief      Inserts the data of view type at the cursor position.
+     *
+     * @param[in]  data  Data to be inserted.
+     */
+    constexpr void insert(std::ranges::view auto data) {
+        insert(gap_id().first, data);
+    }
+
+
+    /**
+     * @brief      Inserts an element of type T at the cursor position.
+     *
+     * @param[in]  t     An element to be inserted.
+     */
+    constexpr void insert(T t) { insert(gap_id().first, t); }
+
+
+    /**
+     * @brief      Inserts \p count copies of \p value at the given position.
+     *             The buffer grows at most once and the copies are filled
+     *             directly into the gap.
+     *
+     * @param[in]  index  A position into which the copies are inserted.
+     * @param[in]  count  The number of copies, nonnegative.
+     * @param[in]  value  The inserted value.
+     */
+    constexpr void insert_n(int64_t index, int64_t count, const T& value) {
+        if !consteval { assert(count >= 0); }
+        auto first = open_gap(index, count);
+        if constexpr (kernels::word_element<T>) {
+            kernels::fill(std::span<T>{first, size_t(count)}, value);
+        } else {
+            std::fill_n(first, count, value);
+        }
+        close_gap(index, count);
+    }
+
+
+    /**
+     * @brief      Inserts \p count repetitions of \p data at the given
+     *             position. The buffer grows at most once, \p data is copied
+     *             once and the rest is produced by doubling the already
+     *             copied part.
+     *
+     * @tparam     V      A view containing elements of type T.
+     *
+     * @param[in]  index  A position into which the repetitions are inserted.
+     * @param[in]  count  The number of repetitions, nonnegative.
+     * @param[in]  data   The repeated data.
+     */
+    template <std::ranges::view V>
+    requires(std::same_as<std::ranges::range_value_t<V>, T>) &&
+            (std::ranges::sized_range<V>)
+    constexpr void insert_repeat(int64_t index, int64_t count, V data) {
+        if !consteval { assert(count >= 0); }
+        int64_t total = count * int64_t(std::ranges::size(data));
+        auto first = open_gap(index, total);
+        int64_t done = total > 0 ? std::ranges::copy(data, first).out - first
+                                 : 0;
+        for (int64_t n; done < total; done += n) {
+            n = std::min(done, total - done);
+            std::copy_n(first, n, first + done);
+        }
+        close_gap(index, total);
+    }
+
+
+    /**
+     * @brief      Pushes a view of data at the front of the content.
+     *
+     * @param[in]  data     Data to be inserted.
+     */
+    constexpr void push_front(std::ranges::view auto data) { insert(0, data); }
+
+
+    /**
+     * @brief      Pushes an element at the front of the content.
+     *
+     * @param[in]  t     Element to be inserted.
+     */
+    constexpr void push_front(T t) { insert(0, t); }
+
+
+    /**
+     * @brief      Pushes a view of data at the end of the content.
+     *
+     * @param[in]  data  Data to be inserted.
+     */
+    constexpr void push_back(std::ranges::view auto data) {
         insert(size(), data);
     }
 
@@ -400,12 +1754,14 @@ class gap_buffer {
         [[assume(index >= 0)]];
         if (count >= 0) {
             count = std::min(count, size() - index);
-            move_cursor_to(index + count);
         } else {
             count = std::min(-count, index + 1);
-            move_cursor_to(index + 1);
+            index = index + 1 - count;
         }
+        before_edit(index, count);
+        move_cursor_to(index + count);
         _gap.advance(-count);
+        after_edit(index, count, 0);
     }
 
 
@@ -427,12 +1783,235 @@ class gap_buffer {
     constexpr void remove_suffix(int64_t count) { remove(size() - 1, -count); }
 
 
+    /**
+     * @brief      Removes many ranges of elements in a single sweep. The gap
+     *             is moved to the first range once and the kept elements
+     *             between the ranges are compacted into it, so the cost is
+     *             linear in the span of the ranges however many there are.
+     *
+     * @tparam     R       A range of [begin, end) pairs of content indexes
+     *                     sorted by begin.
+     *
+     * @param[in]  ranges  The ranges to be removed.
+     * @param[in]  cursor  The cursor position after the removal. By default
+     *                     the cursor stays where the sweep ended, i.e. just
+     *                     after the last kept element preceding the end of
+     *                     the last range. It is clamped to the content.
+     *
+     * @return     The number of removed elements.
+     */
+    template <std::ranges::forward_range R>
+    requires(std::convertible_to<std::ranges::range_value_t<R>,
+                                 std::pair<int64_t, int64_t>>)
+    constexpr int64_t erase_ranges(const R& ranges,
+                                   std::optional<int64_t> cursor = {}) {
+        if (std::ranges::empty(ranges)) { return 0; }
+        std::pair<int64_t, int64_t> front = *std::ranges::begin(ranges);
+        int64_t lo = std::clamp<int64_t>(front.first, 0, size());
+        int64_t hi = lo;
+        for (std::pair<int64_t, int64_t> r : ranges) {
+            hi = std::max(hi, r.second);
+        }
+        hi = std::clamp<int64_t>(hi, lo, size());
+        before_edit(lo, hi - lo);
+        move_cursor_to(lo);
+        auto [gb, ge] = gap_id();
+        auto kept = [&](int64_t i) { return _buf.begin() + ge + (i - lo); };
+        auto out = _buf.begin() + gb;
+        int64_t next = lo;
+        for (std::pair<int64_t, int64_t> r : ranges) {
+            int64_t begin = std::max(r.first, next);
+            int64_t end = std::min(r.second, hi);
+            if (begin >= end) { continue; }
+            out = std::move(kept(next), kept(begin), out);
+            next = end;
+        }
+        out = std::move(kept(next), kept(hi), out);
+        _gap = gap_t{out, kept(hi)};
+        int64_t erased = _gap.size() - (ge - gb);
+        after_edit(lo, hi - lo, hi - lo - erased);
+        if (cursor) { move_cursor_to(std::clamp<int64_t>(*cursor, 0, size())); }
+        return erased;
+    }
+
+
+    /**
+     * @brief      Removes all the elements satisfying \p pred in a single
+     *             sweep over the content, without moving the gap first.
+     *
+     * @param[in]  pred    The predicate.
+     * @param[in]  cursor  The cursor position after the removal, clamped to
+     *                     the content. By default the cursor is put at the
+     *                     end of the content.
+     *
+     * @return     The number of removed elements.
+     */
+    template <typename F>
+    requires(std::predicate<F&, const T&>)
+    constexpr int64_t erase_if(F pred, std::optional<int64_t> cursor = {}) {
+        int64_t old_size = size();
+        before_edit(0, old_size);
+        auto segs = segments();
+        auto out = _buf.begin();
+        int64_t seg = 0, i = 0;
+        // Resumable, so that a throwing pred leaves no moved-from holes: the
+        // elements from the one it threw on are then all kept.
+        auto sweep = [&](bool filter) {
+            for (; seg < 2; ++seg, i = 0) {
+                for (; i < int64_t(segs[seg].size()); ++i) {
+                    T& t = segs[seg][i];
+                    if (filter && pred(std::as_const(t))) { continue; }
+                    if (&*out != &t) { *out = std::move(t); }
+                    ++out;
+                }
+            }
+        };
+        auto finish = [&] {
+            _gap = gap_t{out, _buf.end()};
+            after_edit(0, old_size, size());
+        };
+        try {
+            sweep(true);
+        } catch (...) {
+            sweep(false);
+            finish();
+            throw;
+        }
+        finish();
+        if (cursor) { move_cursor_to(std::clamp<int64_t>(*cursor, 0, size())); }
+        return old_size - size();
+    }
+
+
+    /**
+     * @brief      Inserts a string at the same column of every line in
+     *             [\p first, \p last), e.g. for a block (rectangular) edit.
+     *             The offsets are computed up front from the line index, the
+     *             gap is moved behind the last one and enlarged once, and the
+     *             content in between is shifted right in a single backward
+     *             sweep. Columns count characters, i.e. tabs are not expanded.
+     *
+     * @param[in]  first   The first line.
+     * @param[in]  last    The line after the last one.
+     * @param[in]  column  The column. The string is appended to the lines
+     *                     shorter than that.
+     * @param[in]  text    The inserted string.
+     */
+    constexpr void insert_column(int64_t first, int64_t last, int64_t column,
+                                 std::string_view text)
+    requires(std::same_as<T, char>) {
+        last = std::min(last, line_count());
+        first = std::clamp<int64_t>(first, 0, last);
+        if (first == last || text.empty()) { return; }
+        std::vector<int64_t> offsets;
+        for (int64_t line = first; line < last; ++line) {
+            offsets.push_back(
+                std::min(line_start(line) + column, line_end(line)));
+        }
+        int64_t lo = offsets.front(), hi = offsets.back();
+        int64_t total = int64_t(text.size() * offsets.size());
+        move_cursor_to(hi);
+        enlarge_by_at_least(total - gap_size());
+        before_edit(lo, hi - lo);
+        auto out = _gap.begin() + total;
+        for (int64_t end = hi; int64_t offset : offsets | std::views::reverse) {
+            out = std::ranges::move_backward(_buf.begin() + offset,
+                                             _buf.begin() + end, out)
+                      .out;
+            out = std::ranges::copy_backward(text, out).out;
+            end = offset;
+        }
+        _gap = gap_t{_gap.begin() + total, _gap.end()};
+        after_edit(lo, hi - lo, hi - lo + total);
+    }
+
+
+    /**
+     * @brief      Removes the same columns from every line in
+     *             [\p first, \p last), in a single sweep (see erase_ranges()).
+     *
+     * @param[in]  first   The first line.
+     * @param[in]  last    The line after the last one.
+     * @param[in]  column  The first removed column.
+     * @param[in]  width   The number of removed columns. The lines shorter
+     *                     than \p column + \p width lose only what they have.
+     *
+     * @return     The number of removed characters.
+     */
+    constexpr int64_t erase_column(int64_t first, int64_t last, int64_t column,
+                                   int64_t width)
+    requires(std::same_as<T, char>) {
+        last = std::min(last, line_count());
+        first = std::clamp<int64_t>(first, 0, last);
+        std::vector<std::pair<int64_t, int64_t>> ranges;
+        for (int64_t line = first; line < last; ++line) {
+            int64_t begin = line_start(line), end = line_end(line);
+            ranges.emplace_back(std::min(begin + column, end),
+                                std::min(begin + column + width, end));
+        }
+        return erase_ranges(ranges);
+    }
+
+
     /**
      * @brief      Clears the content. After this operation the size of content
      *             is zero.
      */
     constexpr void clear() {
+        before_edit(0, size());
+        int64_t removed = size();
         _buf.clear();
         _gap = gap_t{_buf};
+        after_edit(0, removed, 0);
+    }
+
+
+    /**
+     * @brief      Lets \p fn modify the range [\p index, \p index + \p count)
+     *             of the content in place, without moving the gap. \p fn gets
+     *             the range as the segments lying before and after the gap
+     *             (see segments()). As far as the statistics and the
+     *             observers are concerned, the range is replaced.
+     *
+     * @param[in]  index  The starting index of the range.
+     * @param[in]  count  The length of the range.
+     * @param[in]  fn     The function modifying the segments.
+     */
+    template <typename F>
+    requires(std::invocable<F&, std::array<std::span<T>, 2>>)
+    constexpr void modify(int64_t index, int64_t count, F fn) {
+        before_edit(index, count);
+        try {
+            fn(segments(index, count));
+        } catch (...) {
+            after_edit(index, count, count);
+            throw;
+        }
+        after_edit(index, count, count);
+    }
+
+
+    /**
+     * @brief      Transforms the range [\p index, \p index + \p count) of the
+     *             content in place, without moving the gap. \p fn is either a
+     *             segment kernel taking std::span<T> (see kernels.hpp), which
+     *             is called once per segment, or a function mapping an
+     *             element to its replacement.
+     *
+     * @param[in]  index  The starting index of the range.
+     * @param[in]  count  The length of the range.
+     * @param[in]  fn     The segment kernel or the element transform.
+     */
+    template <typename F>
+    constexpr void transform_range(int64_t index, int64_t count, F fn) {
+        modify(index, count, [&fn](std::array<std::span<T>, 2> segs) {
+            for (auto seg : segs) {
+                if constexpr (std::invocable<F&, std::span<T>>) {
+                    fn(seg);
+                } else {
+                    std::ranges::transform(seg, seg.begin(), fn);
+                }
+            }
+        });
     }
 };
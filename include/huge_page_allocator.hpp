@@ -0,0 +1,94 @@
+#pragma once
+
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+
+/**
+ * @brief      Allocator meant for multi-GB gap buffers. Storage of at least
+ *             huge_page bytes is rounded up to whole 2 MiB pages, aligned to
+ *             them and, on Linux, advised to be backed by transparent huge
+ *             pages, which cuts the TLB misses of gap moves and scans.
+ *             Smaller storage is aligned to a cache line, so the content
+ *             preceding the gap starts on one.
+ *
+ * @tparam     T     The allocated type.
+ */
+template <typename T>
+class huge_page_allocator {
+  public:
+    using value_type = T;
+
+    static constexpr size_t huge_page = 2 << 20;
+    static constexpr size_t cache_line = 64;
+
+
+  private:
+    /**
+     * @brief      Gets the alignment and the size actually allocated for a
+     *             request.
+     *
+     * @param[in]  n     The number of objects.
+     *
+     * @return     std::pair containing the alignment and the size in bytes.
+     */
+    static constexpr std::pair<size_t, size_t> layout(size_t n) {
+        size_t bytes = n * sizeof(T);
+        size_t align = bytes >= huge_page ? huge_page : cache_line;
+        align = std::max(align, alignof(T));
+        return {align, (bytes + align - 1) / align * align};
+    }
+
+
+  public:
+    constexpr huge_page_allocator() = default;
+
+
+    template <typename U>
+    constexpr huge_page_allocator(const huge_page_allocator<U>&) {}
+
+
+  public:
+    /**
+     * @brief      Allocates storage for \p n objects.
+     *
+     * @param[in]  n     The number of objects.
+     *
+     * @return     The storage.
+     */
+    T* allocate(size_t n) {
+        auto [align, bytes] = layout(n);
+        void* p = ::operator new(bytes, std::align_val_t(align));
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        // Only a hint, the storage works the same if it is refused.
+        if (align == huge_page) { ::madvise(p, bytes, MADV_HUGEPAGE); }
+#endif
+        return static_cast<T*>(p);
+    }
+
+
+    /**
+     * @brief      Deallocates storage obtained from allocate().
+     *
+     * @param      p     The storage.
+     * @param[in]  n     The number of objects it was allocated for.
+     */
+    void deallocate(T* p, size_t n) {
+        auto [align, bytes] = layout(n);
+        ::operator delete(p, bytes, std::align_val_t(align));
+    }
+
+
+    template <typename U>
+    constexpr bool operator==(const huge_page_allocator<U>&) const {
+        return true;
+    }
+};
@@ -0,0 +1,196 @@
+#pragma once
+
+
+#include <concepts>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "block_map.hpp"
+#include "gap_buffer.hpp"
+
+
+/**
+ * @brief      Checks if L is a character level state machine lexer. Such a
+ *             lexer consumes one character at a time and tells the kind of
+ *             the token the consumed character belongs to. A token is then a
+ *             maximal run of characters of the same kind.
+ *
+ * @tparam     L     The lexer type.
+ */
+template <typename L>
+concept state_machine_lexer =
+    std::equality_comparable<typename L::state_type> &&
+    requires(const L& lexer, typename L::state_type state, char c) {
+        { lexer.initial() } -> std::same_as<typename L::state_type>;
+        { lexer.step(state, c) } -> std::same_as<typename L::state_type>;
+        { lexer.kind(state) } -> std::convertible_to<int64_t>;
+    };
+
+
+/**
+ * @brief      Describes a token, i.e. a run of characters of the same kind.
+ */
+struct token {
+    int64_t offset;
+    int64_t length;
+    int64_t kind;
+
+    constexpr bool operator==(const token&) const = default;
+};
+
+
+/**
+ * @brief      This class describes a driver running a state machine lexer
+ *             over a gap_buffer<char> incrementally. The content is split
+ *             into blocks (see block_map) and the lexer state at the end of
+ *             every block is checkpointed. After an edit, lexing restarts at
+ *             the checkpoint preceding the edit and stops as soon as the
+ *             state at a block end after the edit agrees with the old
+ *             checkpoint, so an edit costs O(edited region) unless it
+ *             changes the state of everything after it (e.g. an unclosed
+ *             comment). Tokens never span two blocks.
+ *
+ * @tparam     L     The lexer type.
+ */
+template <state_machine_lexer L>
+class incremental_lexer : public buffer_subscription<gap_buffer<char>> {
+  private:
+    using state_t = typename L::state_type;
+
+    struct chunk {
+        state_t exit{};
+        std::vector<token> tokens{};
+    };
+
+  private:
+    L _lexer;
+    block_map<chunk> _blocks;
+    int64_t _relexed{0};
+
+
+  private:
+    /**
+     * @brief      Lexes a block starting from the given state. The tokens
+     *             are stored with offsets relative to the block.
+     *
+     * @param[in]  i      The block index.
+     * @param[in]  state  The lexer state at the beginning of the block.
+     *
+     * @return     The lexer state at the end of the block.
+     */
+    constexpr state_t lex_block(int64_t i, state_t state) {
+        auto& [exit, tokens] = _blocks.payload(i);
+        tokens.clear();
+        int64_t pos = 0;
+        for (auto seg :
+             _buf->segments(_blocks.block_begin(i), _blocks.block_size(i))) {
+            for (char c : seg) {
+                state = _lexer.step(state, c);
+                int64_t kind = _lexer.kind(state);
+                if (!tokens.empty() && tokens.back().kind == kind) {
+                    ++tokens.back().length;
+                } else {
+                    tokens.push_back({pos, 1, kind});
+                }
+                ++pos;
+            }
+        }
+        ++_relexed;
+        return std::exchange(exit, state);
+    }
+
+
+    /**
+     * @brief      Gets the lexer state at the beginning of a block.
+     *
+     * @param[in]  i     The block index.
+     *
+     * @return     The lexer state.
+     */
+    constexpr state_t entry(int64_t i) const {
+        return i == 0 ? _lexer.initial() : _blocks.payload(i - 1).exit;
+    }
+
+
+  public:
+    /**
+     * @brief      Constructs a new instance of incremental lexer and lexes
+     *             the whole buffer. The buffer has to outlive the driver.
+     *
+     * @param      buf         The lexed buffer.
+     * @param[in]  lexer       The lexer.
+     * @param[in]  block_size  The nominal size of a block.
+     */
+    constexpr incremental_lexer(gap_buffer<char>& buf, L lexer = {},
+                                int64_t block_size = 4096)
+        : buffer_subscription{buf}, _lexer{std::move(lexer)},
+          _blocks{buf.size(), block_size} {
+        for (int64_t i = 0; i < _blocks.size(); ++i) {
+            lex_block(i, entry(i));
+        }
+    }
+
+
+    /**
+     * @brief      Destroys the object. It is spelled out, as GCC 12 rejects
+     *             the implicit one in constant expressions.
+     */
+    constexpr ~incremental_lexer() override {}
+
+
+  public:
+    /**
+     * @brief      Re-lexes the edited blocks and the following ones until the
+     *             lexer state converges with the old checkpoints.
+     *
+     * @param[in]  offset    The content index at which the edit happened.
+     * @param[in]  removed   The number of removed characters.
+     * @param[in]  inserted  The number of inserted characters.
+     */
+    constexpr void on_edit(int64_t offset, int64_t removed,
+                           int64_t inserted) override {
+        auto [first, last, reindexed] =
+            _blocks.edit(offset, removed, inserted);
+        _relexed = 0;
+        // The checkpoints of blocks created by the edit are meaningless.
+        int64_t trusted = reindexed ? last : last - 1;
+        for (int64_t i = first; i < _blocks.size(); ++i) {
+            auto old_exit = lex_block(i, entry(i));
+            if (i >= trusted && old_exit == _blocks.payload(i).exit) { break; }
+        }
+    }
+
+
+    /**
+     * @brief      Gets the number of blocks lexed by the last edit.
+     *
+     * @return     The number of blocks.
+     */
+    constexpr int64_t relexed() const { return _relexed; }
+
+
+    /**
+     * @brief      Provides the tokens overlapping the content range
+     *             [\p first, \p last), e.g. the visible part of a document.
+     *
+     * @param[in]  first  The beginning of the range.
+     * @param[in]  last   The end of the range.
+     *
+     * @return     The tokens with absolute offsets.
+     */
+    constexpr std::vector<token> tokens(int64_t first, int64_t last) const {
+        std::vector<token> result;
+        auto [i, begin] = _blocks.locate(first);
+        for (; i < _blocks.size() && begin < last;
+             begin += _blocks.block_size(i++)) {
+            for (auto [offset, length, kind] : _blocks.payload(i).tokens) {
+                offset += begin;
+                if (offset + length > first && offset < last) {
+                    result.push_back({offset, length, kind});
+                }
+            }
+        }
+        return result;
+    }
+};
@@ -0,0 +1,443 @@
+#pragma once
+
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "cpu_dispatch.hpp"
+
+
+/**
+ * @brief      Segment kernels, i.e. bulk operations working on a contiguous
+ *             piece of content, see gap_buffer::segments(). The kernels
+ *             process 16 bytes at a time when SSE2 is available and fall back
+ *             to plain loops otherwise. The scans of 1 byte elements go to
+ *             the kernels of the tier picked at run time instead, see
+ *             cpu_dispatch.hpp.
+ *
+ *             The kernels are constexpr, so gap_buffer stays usable in
+ *             constant expressions: during constant evaluation only the
+ *             plain loops run, the intrinsics and the dispatched kernels
+ *             are reserved for run time.
+ */
+namespace kernels {
+
+
+/**
+ * @brief      Checks if T can be handled by the word kernels, that is if it
+ *             is 1, 2, 4 or 8 bytes wide and its values compare equal iff
+ *             their bytes do.
+ *
+ * @tparam     T     The element type.
+ */
+template <typename T>
+concept word_element =
+    std::has_unique_object_representations_v<T> &&
+    (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8);
+
+
+#if defined(__SSE2__)
+/**
+ * @brief      The vector operations of the word kernels for elements of the
+ *             given size.
+ *
+ * @tparam     N     The element size.
+ */
+template <std::size_t N>
+struct lanes;
+
+template <>
+struct lanes<1> {
+    using word = uint8_t;
+
+    static __m128i splat(word v) { return _mm_set1_epi8(char(v)); }
+    static __m128i equal(__m128i a, __m128i b) { return _mm_cmpeq_epi8(a, b); }
+};
+
+template <>
+struct lanes<2> {
+    using word = uint16_t;
+
+    static __m128i splat(word v) { return _mm_set1_epi16(short(v)); }
+    static __m128i equal(__m128i a, __m128i b) {
+        return _mm_cmpeq_epi16(a, b);
+    }
+};
+
+template <>
+struct lanes<4> {
+    using word = uint32_t;
+
+    static __m128i splat(word v) { return _mm_set1_epi32(int(v)); }
+    static __m128i equal(__m128i a, __m128i b) {
+        return _mm_cmpeq_epi32(a, b);
+    }
+};
+
+template <>
+struct lanes<8> {
+    using word = uint64_t;
+
+    static __m128i splat(word v) { return _mm_set1_epi64x(int64_t(v)); }
+    // SSE2 has no 64-bit compare, both halves have to be equal.
+    static __m128i equal(__m128i a, __m128i b) {
+        auto halves = _mm_cmpeq_epi32(a, b);
+        auto swapped = _mm_shuffle_epi32(halves, _MM_SHUFFLE(2, 3, 0, 1));
+        return _mm_and_si128(halves, swapped);
+    }
+};
+
+
+/**
+ * @brief      Broadcasts an element to all the lanes of a vector.
+ *
+ * @param[in]  value  The element.
+ *
+ * @return     The vector.
+ */
+template <word_element T>
+__m128i splat(const T& value) {
+    using word = typename lanes<sizeof(T)>::word;
+    return lanes<sizeof(T)>::splat(std::bit_cast<word>(value));
+}
+
+
+/**
+ * @brief      Compares the 16 bytes at \p p with a broadcast element.
+ *
+ * @param[in]  p       The compared elements.
+ * @param[in]  needle  The broadcast element, see splat().
+ *
+ * @return     The byte mask of the equal elements, each element setting
+ *             sizeof(T) bits.
+ */
+template <word_element T>
+uint32_t match_mask(const T* p, __m128i needle) {
+    auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    return _mm_movemask_epi8(lanes<sizeof(T)>::equal(v, needle));
+}
+#endif
+
+
+/**
+ * @brief      Fills a segment with an element. With SSE2 the element is
+ *             broadcast and stored 16 bytes at a time.
+ *
+ * @param[in]  seg    The segment.
+ * @param[in]  value  The element.
+ */
+template <word_element T>
+constexpr void fill(std::span<T> seg, const T& value) {
+    T* p = seg.data();
+    T* end = p + seg.size();
+#if defined(__SSE2__)
+    if !consteval {
+        constexpr int64_t step = 16 / sizeof(T);
+        auto v = splat(value);
+        for (; end - p >= step; p += step) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+        }
+    }
+#endif
+    for (; p != end; ++p) { *p = value; }
+}
+
+
+/**
+ * @brief      Finds the first occurrence of an element in a segment. With
+ *             SSE2, 16 bytes are compared at a time.
+ *
+ * @param[in]  seg    The segment.
+ * @param[in]  value  The searched element.
+ *
+ * @return     The index of the occurrence or -1 if there is none.
+ */
+template <word_element T>
+constexpr int64_t find(std::span<const T> seg, const T& value) {
+    const T* begin = seg.data();
+    const T* p = begin;
+    const T* end = p + seg.size();
+    if !consteval {
+        if constexpr (sizeof(T) == 1) {
+            return active().find(reinterpret_cast<const char*>(begin),
+                                 seg.size(), std::bit_cast<char>(value));
+        }
+#if defined(__SSE2__)
+        constexpr int64_t step = 16 / sizeof(T);
+        auto needle = splat(value);
+        for (; end - p >= step; p += step) {
+            if (uint32_t mask = match_mask(p, needle)) {
+                return p - begin + std::countr_zero(mask) / int64_t(sizeof(T));
+            }
+        }
+#endif
+    }
+    for (; p != end; ++p) {
+        if (*p == value) { return p - begin; }
+    }
+    return -1;
+}
+
+
+/**
+ * @brief      Counts the occurrences of an element in a segment. With SSE2,
+ *             16 bytes are compared at a time and the hits are popcounted.
+ *
+ * @param[in]  seg    The segment.
+ * @param[in]  value  The counted element.
+ *
+ * @return     The number of occurrences.
+ */
+template <word_element T>
+constexpr int64_t count(std::span<const T> seg, const T& value) {
+    const T* p = seg.data();
+    const T* end = p + seg.size();
+    int64_t count = 0;
+    if !consteval {
+        if constexpr (sizeof(T) == 1) {
+            return active().count(reinterpret_cast<const char*>(p),
+                                  seg.size(), std::bit_cast<char>(value));
+        }
+#if defined(__SSE2__)
+        constexpr int64_t step = 16 / sizeof(T);
+        auto needle = splat(value);
+        for (; end - p >= step; p += step) {
+            count += std::popcount(match_mask(p, needle)) / int64_t(sizeof(T));
+        }
+#endif
+    }
+    for (; p != end; ++p) { count += *p == value; }
+    return count;
+}
+
+
+/**
+ * @brief      Finds the first position at which two segments of the same
+ *             size differ.
+ *
+ * @param[in]  a     The first segment.
+ * @param[in]  b     The second segment.
+ *
+ * @return     The index of the first difference or the size if there is
+ *             none.
+ */
+template <word_element T>
+constexpr int64_t mismatch(std::span<const T> a, std::span<const T> b) {
+    if !consteval {
+        if constexpr (sizeof(T) == 1) {
+            return active().mismatch(reinterpret_cast<const char*>(a.data()),
+                                     reinterpret_cast<const char*>(b.data()),
+                                     a.size());
+        }
+    }
+    return std::ranges::mismatch(a, b).in1 - a.begin();
+}
+
+
+/**
+ * @brief      Scans a segment backwards, memrchr style, for the occurrences
+ *             of an element until \p limit of them are found. With SSE2 the
+ *             scan compares 16 bytes at a time and counts the hits with a
+ *             popcount of the comparison mask.
+ *
+ * @param[in]  seg    The segment.
+ * @param[in]  value  The searched element.
+ * @param[in]  limit  The number of occurrences after which the scan stops.
+ *
+ * @return     std::pair containing the number of occurrences found (at
+ *             most \p limit) and the index of the last one found, i.e. the
+ *             leftmost, or -1 if there is none.
+ */
+template <word_element T>
+constexpr std::pair<int64_t, int64_t> rcount(std::span<const T> seg,
+                                             const T& value, int64_t limit) {
+    const T* begin = seg.data();
+    const T* p = begin + seg.size();
+    int64_t count = 0, last = -1;
+    if (limit <= 0) { return {count, last}; }
+    if !consteval {
+        if constexpr (sizeof(T) == 1) {
+            return active().rcount(reinterpret_cast<const char*>(begin),
+                                   seg.size(), std::bit_cast<char>(value),
+                                   limit);
+        }
+#if defined(__SSE2__)
+        constexpr int64_t size = sizeof(T), step = 16 / size;
+        auto needle = splat(value);
+        for (; p - begin >= step; p -= step) {
+            uint32_t mask = match_mask(p - step, needle);
+            if (mask == 0) { continue; }
+            int64_t hits = std::popcount(mask) / size;
+            if (count + hits < limit) {
+                count += hits;
+                last = p - step - begin + std::countr_zero(mask) / size;
+                continue;
+            }
+            while (true) {
+                int64_t i = (std::bit_width(mask) - 1) / size;
+                if (++count == limit) {
+                    return {count, p - step - begin + i};
+                }
+                mask &= ~(((1u << size) - 1) << (i * size));
+            }
+        }
+#endif
+    }
+    while (p != begin) {
+        if (*--p == value) {
+            last = p - begin;
+            if (++count == limit) { break; }
+        }
+    }
+    return {count, last};
+}
+
+
+/**
+ * @brief      Finds the last occurrence of an element in a segment, see
+ *             rcount().
+ *
+ * @param[in]  seg    The segment.
+ * @param[in]  value  The searched element.
+ *
+ * @return     The index of the occurrence or -1 if there is none.
+ */
+template <word_element T>
+constexpr int64_t rfind(std::span<const T> seg, const T& value) {
+    return rcount(seg, value, 1).second;
+}
+
+
+/**
+ * @brief      Applies a byte transform to a segment. With SSE2 the bulk is
+ *             processed 16 bytes at a time by \p vector and only the tail by
+ *             \p scalar.
+ *
+ * @param[in]  seg     The segment.
+ * @param[in]  vector  The transform of a 16 byte vector.
+ * @param[in]  scalar  The transform of a single byte.
+ */
+constexpr void for_each_byte(std::span<char> seg,
+                             [[maybe_unused]] auto vector, auto scalar) {
+    char* p = seg.data();
+    char* end = p + seg.size();
+#if defined(__SSE2__)
+    if !consteval {
+        for (; end - p >= 16; p += 16) {
+            auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(p), vector(v));
+        }
+    }
+#endif
+    for (; p != end; ++p) { *p = scalar(*p); }
+}
+
+
+#if defined(__SSE2__)
+/**
+ * @brief      Flips the case bit of the bytes lying in [\p lo, \p hi].
+ *
+ * @param[in]  v     The vector of bytes.
+ * @param[in]  lo    The lowest flipped byte.
+ * @param[in]  hi    The highest flipped byte.
+ *
+ * @return     The transformed vector.
+ */
+inline __m128i flip_case(__m128i v, char lo, char hi) {
+    auto in_range = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)),
+                                  _mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1)));
+    return _mm_xor_si128(v, _mm_and_si128(in_range, _mm_set1_epi8(32)));
+}
+#define REFFUB_VECTOR(...) [=, this](__m128i v) { return __VA_ARGS__; }
+#else
+#define REFFUB_VECTOR(...) nullptr
+#endif
+
+
+/**
+ * @brief      Maps ASCII letters to upper case.
+ */
+struct to_upper {
+    constexpr void operator()(std::span<char> seg) const {
+        for_each_byte(seg, REFFUB_VECTOR(flip_case(v, 'a', 'z')),
+                      [](char c) -> char {
+                          return 'a' <= c && c <= 'z' ? c ^ 32 : c;
+                      });
+    }
+};
+
+
+/**
+ * @brief      Maps ASCII letters to lower case.
+ */
+struct to_lower {
+    constexpr void operator()(std::span<char> seg) const {
+        for_each_byte(seg, REFFUB_VECTOR(flip_case(v, 'A', 'Z')),
+                      [](char c) -> char {
+                          return 'A' <= c && c <= 'Z' ? c ^ 32 : c;
+                      });
+    }
+};
+
+
+/**
+ * @brief      Replaces every occurrence of a character with another one,
+ *             e.g. tabs with spaces.
+ */
+struct replace {
+    char from;
+    char to;
+
+    constexpr void operator()(std::span<char> seg) const {
+        for_each_byte(
+            seg,
+            REFFUB_VECTOR(_mm_or_si128(
+                _mm_and_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(from)),
+                              _mm_set1_epi8(to)),
+                _mm_andnot_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(from)), v))),
+            [this](char c) { return c == from ? to : c; });
+    }
+};
+
+
+/**
+ * @brief      XORs every byte with a key.
+ */
+struct bitwise_xor {
+    char key;
+
+    constexpr void operator()(std::span<char> seg) const {
+        for_each_byte(seg, REFFUB_VECTOR(_mm_xor_si128(v, _mm_set1_epi8(key))),
+                      [this](char c) -> char { return c ^ key; });
+    }
+};
+
+
+#undef REFFUB_VECTOR
+
+
+/**
+ * @brief      Maps every byte through a 256 entry translation table. There
+ *             is no byte shuffle wide enough for the table in SSE2, so this
+ *             is a plain loop left to the auto-vectorizer.
+ */
+struct translate {
+    std::array<char, 256> table;
+
+    constexpr void operator()(std::span<char> seg) const {
+        for (char& c : seg) { c = table[uint8_t(c)]; }
+    }
+};
+
+
+}  // namespace kernels
@@ -0,0 +1,221 @@
+#pragma once
+
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "gap_buffer.hpp"
+
+
+/**
+ * @brief      This class describes a text stored as a gap buffer of lines,
+ *             each line being a gap_buffer<char> of its own and none of them
+ *             holding the '\n' separators. The outer buffer only holds
+ *             pointers, so moving its gap never touches the lines, and the
+ *             lines are taken from a pool which keeps the allocations of
+ *             the removed ones for reuse. Splitting and joining lines costs
+ *             O(line length) no matter how long the text is.
+ *
+ *             The cursor is a (line, column) pair, the gap of the line under
+ *             the cursor follows it, so typing is O(1) per character.
+ */
+class line_gap_buffer {
+  private:
+    using line_t = gap_buffer<char>;
+
+  private:
+    std::vector<std::unique_ptr<line_t>> _pool{};
+    std::vector<line_t*> _free{};
+    gap_buffer<line_t*> _lines{};
+    int64_t _line{0};
+    int64_t _column{0};
+
+
+  private:
+    /**
+     * @brief      Takes an empty line out of the pool, allocating a new one
+     *             only if there is no free line.
+     *
+     * @return     The line.
+     */
+    constexpr line_t* acquire() {
+        if (_free.empty()) {
+            return _pool.emplace_back(std::make_unique<line_t>()).get();
+        }
+        line_t* line = _free.back();
+        _free.pop_back();
+        return line;
+    }
+
+
+    /**
+     * @brief      Gives a line back to the pool. The line is cleared but keeps
+     *             its internal buffer.
+     *
+     * @param      line  The line.
+     */
+    constexpr void release(line_t* line) {
+        line->clear();
+        _free.push_back(line);
+    }
+
+
+  public:
+    /**
+     * @brief      Constructs a new instance of line gap buffer holding a single
+     *             empty line.
+     */
+    constexpr line_gap_buffer() { _lines.push_back(acquire()); }
+
+
+    /**
+     * @brief      Constructs a new instance of line gap buffer holding the
+     *             given text, with the cursor at its beginning.
+     *
+     * @param[in]  text  The text.
+     */
+    constexpr explicit line_gap_buffer(std::string_view text)
+        : line_gap_buffer() {
+        insert(text);
+        move_cursor(0, 0);
+    }
+
+
+    line_gap_buffer(const line_gap_buffer&) = delete;
+    line_gap_buffer& operator=(const line_gap_buffer&) = delete;
+
+
+  public:
+    /**
+     * @brief      Gets the number of lines.
+     *
+     * @return     The number of lines, at least one.
+     */
+    constexpr int64_t line_count() const { return _lines.size(); }
+
+
+    /**
+     * @brief      Gets a line.
+     *
+     * @param[in]  line  The line index belonging to [0, line_count()).
+     *
+     * @return     A reference to the line.
+     */
+    constexpr line_t& line(int64_t line) {
+        auto [left, right] = _lines.segments(line, 1);
+        return *(left.empty() ? right.front() : left.front());
+    }
+
+
+    /**
+     * @brief      Gets the cursor position.
+     *
+     * @return     std::pair containing the line and the column of the
+     *             cursor.
+     */
+    constexpr std::pair<int64_t, int64_t> cursor() const {
+        return {_line, _column};
+    }
+
+
+    /**
+     * @brief      Moves the cursor. The position is clamped to the text.
+     *
+     * @param[in]  line    The line.
+     * @param[in]  column  The column.
+     */
+    constexpr void move_cursor(int64_t line, int64_t column) {
+        _line = std::clamp<int64_t>(line, 0, line_count() - 1);
+        _column = std::clamp<int64_t>(column, 0, this->line(_line).size());
+    }
+
+
+    /**
+     * @brief      Inserts a text at the cursor and moves the cursor past it.
+     *             Every '\n' of the text splits the line.
+     *
+     * @param[in]  text  The text.
+     */
+    constexpr void insert(std::string_view text) {
+        while (true) {
+            auto piece = text.substr(0, text.find('\n'));
+            line(_line).insert(_column, piece);
+            _column += piece.size();
+            if (piece.size() == text.size()) { return; }
+            split_line();
+            text.remove_prefix(piece.size() + 1);
+        }
+    }
+
+
+    /**
+     * @brief      Splits the line at the cursor, as if '\n' was typed. The
+     *             cursor goes to the beginning of the new line.
+     */
+    constexpr void split_line() {
+        line_t& head = line(_line);
+        line_t* tail = acquire();
+        for (auto seg : head.segments(_column, head.size() - _column)) {
+            tail->push_back(seg);
+        }
+        head.remove(_column, head.size() - _column);
+        _lines.insert(++_line, tail);
+        _column = 0;
+    }
+
+
+    /**
+     * @brief      Appends the line following the cursor line to it, as if
+     *             the '\n' ending the cursor line was removed. The cursor
+     *             stays where it is.
+     */
+    constexpr void join_line() {
+        if (_line + 1 == line_count()) { return; }
+        line_t& head = line(_line);
+        line_t* tail = &line(_line + 1);
+        for (auto seg : tail->segments()) { head.push_back(seg); }
+        _lines.remove(_line + 1, 1);
+        release(tail);
+    }
+
+
+    /**
+     * @brief      Removes characters following the cursor. A line end counts
+     *             as one character.
+     *
+     * @param[in]  count  The number of characters to be removed.
+     */
+    constexpr void remove(int64_t count) {
+        while (count > 0) {
+            line_t& current = line(_line);
+            int64_t n = std::min(count, current.size() - _column);
+            if (n > 0) { current.remove(_column, n); }
+            count -= n;
+            if (count == 0 || _line + 1 == line_count()) { return; }
+            join_line();
+            --count;
+        }
+    }
+
+
+    /**
+     * @brief      Gets the whole text, with the lines separated by '\n'.
+     *
+     * @return     The text.
+     */
+    constexpr std::string text() {
+        std::string result;
+        for (int64_t i = 0; i < line_count(); ++i) {
+            if (i > 0) { result += '\n'; }
+            for (auto seg : line(i).segments()) {
+                result.append(seg.begin(), seg.end());
+            }
+        }
+        return result;
+    }
+};
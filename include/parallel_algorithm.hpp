@@ -0,0 +1,203 @@
+#pragma once
+
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "gap_buffer.hpp"
+#include "thread_pool.hpp"
+
+
+/**
+ * @brief      A contiguous piece of a gap buffer content together with its
+ *             content index.
+ *
+ * @tparam     T     The type held by the buffer.
+ */
+template <typename T>
+struct content_chunk {
+    int64_t offset;
+    std::span<T> data;
+};
+
+
+/**
+ * @brief      Splits segments of a gap buffer content into chunks of
+ *             (almost) equal sizes. A chunk never crosses the gap.
+ *
+ * @tparam     T         The type held by the buffer.
+ *
+ * @param[in]  segments  The segments, see gap_buffer::segments().
+ * @param[in]  parts     The number of chunks aimed at.
+ * @param[in]  grain     The minimal size of a chunk.
+ *
+ * @return     The chunks in the content order.
+ */
+template <typename T>
+std::vector<content_chunk<T>> split_into_chunks(
+    std::array<std::span<T>, 2> segments, int64_t parts,
+    int64_t grain = 1 << 16) {
+    int64_t total = segments[0].size() + segments[1].size();
+    parts = std::max<int64_t>(parts, 1);
+    int64_t length = std::max((total + parts - 1) / parts, grain);
+    std::vector<content_chunk<T>> chunks;
+    int64_t offset = 0;
+    for (auto seg : segments) {
+        for (int64_t i = 0; i < int64_t(seg.size()); i += length) {
+            int64_t n = std::min<int64_t>(length, seg.size() - i);
+            chunks.push_back({offset + i, seg.subspan(i, n)});
+        }
+        offset += seg.size();
+    }
+    return chunks;
+}
+
+
+/**
+ * @brief      Calls \p fn with the index of every chunk, on the workers of
+ *             \p pool and on the calling thread, and waits until all of
+ *             them are done. The chunks are claimed one by one by whichever
+ *             thread is free, so the caller never waits for a task queued
+ *             behind others and may itself be a task of \p pool. The first
+ *             exception thrown by \p fn is rethrown once all the chunks are
+ *             done.
+ *
+ * @param      pool    The pool.
+ * @param[in]  chunks  The number of chunks.
+ * @param[in]  fn      The function processing a chunk.
+ */
+template <typename F>
+void for_each_chunk(thread_pool& pool, int64_t chunks, F fn) {
+    struct progress {
+        std::atomic<int64_t> next{0};
+        std::mutex mutex{};
+        std::condition_variable finished{};
+        int64_t done{0};
+        std::exception_ptr error{};
+    };
+    // The helpers which start late only touch the shared progress.
+    auto state = std::make_shared<progress>();
+    auto work = [state, chunks, &fn] {
+        for (int64_t i; (i = state->next++) < chunks;) {
+            std::exception_ptr error;
+            try {
+                fn(i);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            std::scoped_lock lock{state->mutex};
+            if (error && !state->error) { state->error = error; }
+            if (++state->done == chunks) { state->finished.notify_all(); }
+        }
+    };
+    for (int64_t k = std::min(chunks - 1, pool.size()); k > 0; --k) {
+        pool.submit(work);
+    }
+    work();
+    std::unique_lock lock{state->mutex};
+    state->finished.wait(lock, [&] { return state->done == chunks; });
+    if (state->error) { std::rethrow_exception(state->error); }
+}
+
+
+/**
+ * @brief      Calls \p fn for every element of the content. The content is
+ *             split into chunks which are processed on \p pool.
+ *
+ * @param      pool  The pool.
+ * @param[in]  buf   The buffer.
+ * @param[in]  fn    The function called with a const reference to every
+ *                   element.
+ */
+template <typename T, typename A, typename F>
+void for_each(thread_pool& pool, gap_buffer<T, A>& buf, F fn) {
+    auto chunks = split_into_chunks(buf.segments(), 4 * pool.size());
+    for_each_chunk(pool, chunks.size(), [&](int64_t i) {
+        for (const T& t : chunks[i].data) { fn(t); }
+    });
+}
+
+
+/**
+ * @brief      Replaces every element of the content with the result of
+ *             \p fn applied to it. The content is split into chunks which are
+ *             processed on \p pool. See gap_buffer::modify().
+ *
+ * @param      pool  The pool.
+ * @param[in]  buf   The buffer.
+ * @param[in]  fn    The function mapping an element to its replacement.
+ */
+template <typename T, typename A, typename F>
+void transform(thread_pool& pool, gap_buffer<T, A>& buf, F fn) {
+    buf.modify(0, buf.size(), [&](std::array<std::span<T>, 2> segments) {
+        auto chunks = split_into_chunks(segments, 4 * pool.size());
+        for_each_chunk(pool, chunks.size(), [&](int64_t i) {
+            std::ranges::transform(chunks[i].data, chunks[i].data.begin(),
+                                   fn);
+        });
+    });
+}
+
+
+/**
+ * @brief      Counts the elements of the content satisfying \p pred. The
+ *             content is split into chunks which are processed on \p pool.
+ *
+ * @param      pool  The pool.
+ * @param[in]  buf   The buffer.
+ * @param[in]  pred  The predicate.
+ *
+ * @return     The number of elements satisfying \p pred.
+ */
+template <typename T, typename A, typename F>
+int64_t count_if(thread_pool& pool, gap_buffer<T, A>& buf, F pred) {
+    auto chunks = split_into_chunks(buf.segments(), 4 * pool.size());
+    std::vector<int64_t> counts(chunks.size());
+    for_each_chunk(pool, chunks.size(), [&](int64_t i) {
+        counts[i] = std::ranges::count_if(chunks[i].data, pred);
+    });
+    return std::reduce(counts.begin(), counts.end(), int64_t{0});
+}
+
+
+/**
+ * @brief      Finds the first element of the content satisfying \p pred. The
+ *             content is split into chunks which are processed on \p pool.
+ *             The chunks lying after one where an element was found are
+ *             skipped.
+ *
+ * @param      pool  The pool.
+ * @param[in]  buf   The buffer.
+ * @param[in]  pred  The predicate.
+ *
+ * @return     The index of the element, if any.
+ */
+template <typename T, typename A, typename F>
+std::optional<int64_t> find_if(thread_pool& pool, gap_buffer<T, A>& buf,
+                               F pred) {
+    constexpr int64_t none = std::numeric_limits<int64_t>::max();
+    auto chunks = split_into_chunks(buf.segments(), 4 * pool.size());
+    std::atomic<int64_t> found{none};
+    for_each_chunk(pool, chunks.size(), [&](int64_t i) {
+        auto [offset, data] = chunks[i];
+        if (offset >= found.load(std::memory_order_relaxed)) { return; }
+        auto it = std::ranges::find_if(data, pred);
+        if (it == data.end()) { return; }
+        int64_t hit = offset + (it - data.begin());
+        int64_t seen = found.load(std::memory_order_relaxed);
+        while (hit < seen && !found.compare_exchange_weak(seen, hit)) {}
+    });
+    if (found == none) { return std::nullopt; }
+    return found.load();
+}
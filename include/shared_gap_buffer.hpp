@@ -0,0 +1,348 @@
+#pragma once
+
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/**
+ * @brief      Header at the beginning of the shared memory region of a
+ *             shared_gap_buffer. The content follows it, laid out like the
+ *             internal buffer of a gap buffer. Readers take a consistent
+ *             snapshot with the seqlock protocol: \p seq is odd while the
+ *             writer is editing and is bumped by two by every edit.
+ */
+struct alignas(64) shared_gap_header {
+    static constexpr uint32_t magic_value = 0x72656666;
+    static constexpr uint32_t version_value = 1;
+
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+    std::atomic<uint64_t> seq;
+    std::atomic<uint64_t> gap_begin;
+    std::atomic<uint64_t> gap_end;
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free);
+};
+
+
+/**
+ * @brief      This class describes a gap buffer of characters living in a
+ *             memfd shared memory region, so that other processes (e.g. a
+ *             renderer or a language server) can map the same fd read-only
+ *             with shared_gap_reader and read the content without copying
+ *             it. The region is reserved for a fixed capacity up front;
+ *             the file is sparse, so only the touched pages cost memory.
+ *             There is no reallocation, as readers could not follow the
+ *             content to a new region. Linux only.
+ *
+ *             The object is the only writer of the region.
+ */
+class shared_gap_buffer {
+  private:
+    int _fd{-1};
+    int64_t _capacity;
+    shared_gap_header* _header{nullptr};
+    char* _data{nullptr};
+    int64_t _gb{0};
+    int64_t _ge;
+
+
+  private:
+    /**
+     * @brief      Throws the error reported by a failed system call.
+     *
+     * @param[in]  what  The name of the call.
+     */
+    [[noreturn]] static void fail(const char* what) {
+        throw std::system_error(errno, std::system_category(), what);
+    }
+
+
+    /**
+     * @brief      Starts an edit, making the readers retry.
+     */
+    void begin_write() {
+        _header->seq.store(_header->seq.load(std::memory_order_relaxed) + 1,
+                           std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+
+    /**
+     * @brief      Publishes the gap and ends an edit.
+     */
+    void end_write() {
+        _header->gap_begin.store(_gb, std::memory_order_relaxed);
+        _header->gap_end.store(_ge, std::memory_order_relaxed);
+        _header->seq.store(_header->seq.load(std::memory_order_relaxed) + 1,
+                           std::memory_order_release);
+    }
+
+
+    /**
+     * @brief      Moves the gap to the given content index.
+     *
+     * @param[in]  index  The index belonging to [0, size()].
+     */
+    void move_gap(int64_t index) {
+        if (index < _gb) {
+            std::memmove(_data + _ge - (_gb - index), _data + index,
+                         _gb - index);
+        } else {
+            std::memmove(_data + _gb, _data + _ge, index - _gb);
+        }
+        _ge += index - _gb;
+        _gb = index;
+    }
+
+
+  public:
+    /**
+     * @brief      Constructs a new instance of shared gap buffer on a new
+     *             memfd region.
+     *
+     * @param[in]  capacity  The maximal size of the content.
+     * @param[in]  name      The name of the memfd, for debugging only.
+     *
+     * @throws     std::system_error if the region cannot be created.
+     */
+    explicit shared_gap_buffer(int64_t capacity,
+                               const char* name = "reffub")
+        : _capacity{capacity}, _ge{capacity} {
+        _fd = ::memfd_create(name, MFD_CLOEXEC);
+        if (_fd < 0) { fail("memfd_create"); }
+        int64_t bytes = sizeof(shared_gap_header) + capacity;
+        void* map = MAP_FAILED;
+        if (::ftruncate(_fd, bytes) == 0) {
+            map = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         _fd, 0);
+        }
+        if (map == MAP_FAILED) {
+            int error = errno;
+            ::close(_fd);
+            errno = error;
+            fail("mmap");
+        }
+        _header = ::new (map) shared_gap_header{
+            shared_gap_header::magic_value, shared_gap_header::version_value,
+            uint64_t(capacity), 0, 0, uint64_t(capacity)};
+        _data = reinterpret_cast<char*>(_header + 1);
+    }
+
+
+    shared_gap_buffer(const shared_gap_buffer&) = delete;
+    shared_gap_buffer& operator=(const shared_gap_buffer&) = delete;
+
+
+    /**
+     * @brief      Unmaps the region and closes the fd. Readers keep their own
+     *             mappings alive.
+     */
+    ~shared_gap_buffer() {
+        ::munmap(_header, sizeof(shared_gap_header) + _capacity);
+        ::close(_fd);
+    }
+
+
+  public:
+    /**
+     * @brief      Gets the fd of the region, to be passed to the readers.
+     *
+     * @return     The fd.
+     */
+    int fd() const { return _fd; }
+
+
+    /**
+     * @brief      Gets the content size.
+     *
+     * @return     The content size.
+     */
+    int64_t size() const { return _capacity - (_ge - _gb); }
+
+
+    /**
+     * @brief      Gets the maximal content size.
+     *
+     * @return     The capacity.
+     */
+    int64_t capacity() const { return _capacity; }
+
+
+    /**
+     * @brief      Provides the content as the parts before and after the gap.
+     *
+     * @return     std::array of the two parts.
+     */
+    std::array<std::string_view, 2> segments() const {
+        return {std::string_view{_data, size_t(_gb)},
+                std::string_view{_data + _ge, size_t(_capacity - _ge)}};
+    }
+
+
+    /**
+     * @brief      Inserts a string at the given index.
+     *
+     * @param[in]  index  The index belonging to [0, size()]. It is clamped
+     *                    to the content.
+     * @param[in]  data   The inserted string.
+     *
+     * @throws     std::length_error if the capacity would be exceeded.
+     */
+    void insert(int64_t index, std::string_view data) {
+        if (int64_t(data.size()) > _ge - _gb) {
+            throw std::length_error("shared_gap_buffer capacity exceeded");
+        }
+        index = std::clamp<int64_t>(index, 0, size());
+        begin_write();
+        move_gap(index);
+        std::memcpy(_data + _gb, data.data(), data.size());
+        _gb += data.size();
+        end_write();
+    }
+
+
+    /**
+     * @brief      Removes a range of the content.
+     *
+     * @param[in]  index  The index of the first removed character.
+     * @param[in]  count  The number of removed characters. The range is
+     *                    clamped to the content.
+     */
+    void remove(int64_t index, int64_t count) {
+        index = std::clamp<int64_t>(index, 0, size());
+        count = std::clamp<int64_t>(count, 0, size() - index);
+        begin_write();
+        move_gap(index);
+        _ge += count;
+        end_write();
+    }
+};
+
+
+/**
+ * @brief      This class describes a read-only mapping of the region of a
+ *             shared_gap_buffer, typically in another process.
+ */
+class shared_gap_reader {
+  private:
+    const shared_gap_header* _header{nullptr};
+    const char* _data{nullptr};
+    int64_t _bytes{0};
+
+
+  public:
+    /**
+     * @brief      Constructs a new instance of shared gap reader. The fd may be
+     *             closed afterwards.
+     *
+     * @param[in]  fd    The fd of the region, see shared_gap_buffer::fd().
+     *
+     * @throws     std::system_error if the region cannot be mapped and
+     *             std::runtime_error if it is not a shared gap buffer of a
+     *             known version.
+     */
+    explicit shared_gap_reader(int fd) {
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            throw std::system_error(errno, std::system_category(), "fstat");
+        }
+        _bytes = st.st_size;
+        if (_bytes < int64_t(sizeof(shared_gap_header))) {
+            throw std::runtime_error("not a shared gap buffer");
+        }
+        void* map = ::mmap(nullptr, _bytes, PROT_READ, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            throw std::system_error(errno, std::system_category(), "mmap");
+        }
+        _header = static_cast<const shared_gap_header*>(map);
+        _data = reinterpret_cast<const char*>(_header + 1);
+        if (_header->magic != shared_gap_header::magic_value ||
+            _header->version != shared_gap_header::version_value ||
+            int64_t(sizeof(shared_gap_header) + _header->capacity) !=
+                _bytes) {
+            ::munmap(map, _bytes);
+            throw std::runtime_error("not a shared gap buffer");
+        }
+    }
+
+
+    shared_gap_reader(const shared_gap_reader&) = delete;
+    shared_gap_reader& operator=(const shared_gap_reader&) = delete;
+
+
+    /**
+     * @brief      Unmaps the region and destroys the object.
+     */
+    ~shared_gap_reader() {
+        ::munmap(const_cast<shared_gap_header*>(_header), _bytes);
+    }
+
+
+  public:
+    /**
+     * @brief      Gets the number of edits done so far, e.g. to tell if the
+     *             content changed since the last read.
+     *
+     * @return     The number of edits.
+     */
+    uint64_t version() const {
+        return _header->seq.load(std::memory_order_acquire) / 2;
+    }
+
+
+    /**
+     * @brief      Calls \p fn with the content as the parts before and after
+     *             the gap, directly in the shared region, and returns its
+     *             result once the content is known to have stayed intact
+     *             during the call. Otherwise the call is repeated, so \p fn
+     *             must not act on what it reads before it returns and must
+     *             cope with garbage.
+     *
+     * @param[in]  fn    The function reading the content.
+     *
+     * @return     The result of \p fn on a consistent snapshot.
+     */
+    template <typename F>
+    requires(std::invocable<F&, std::array<std::string_view, 2>>)
+    auto read(F fn) const {
+        using result_t =
+            std::invoke_result_t<F&, std::array<std::string_view, 2>>;
+        uint64_t capacity = _header->capacity;
+        while (true) {
+            uint64_t seq = _header->seq.load(std::memory_order_acquire);
+            uint64_t gb = _header->gap_begin.load(std::memory_order_relaxed);
+            uint64_t ge = _header->gap_end.load(std::memory_order_relaxed);
+            if (seq % 2 == 1 || gb > ge || ge > capacity) { continue; }
+            std::array segments{std::string_view{_data, gb},
+                                std::string_view{_data + ge, capacity - ge}};
+            auto consistent = [&] {
+                std::atomic_thread_fence(std::memory_order_acquire);
+                return _header->seq.load(std::memory_order_relaxed) == seq;
+            };
+            if constexpr (std::is_void_v<result_t>) {
+                fn(segments);
+                if (consistent()) { return; }
+            } else {
+                result_t result = fn(segments);
+                if (consistent()) { return result; }
+            }
+        }
+    }
+};
@@ -0,0 +1,229 @@
+#pragma once
+
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+
+/**
+ * @brief      This class describes an arena serving many small allocations,
+ *             e.g. the internal buffers of hundreds of thousands of short
+ *             gap buffers. Requests are rounded up to a power of two size
+ *             class between 16 bytes and 4 KiB. Every class carves its blocks
+ *             out of 64 KiB pages shared by all the buffers and keeps the
+ *             freed blocks in an intrusive free list, so both allocation and
+ *             deallocation are a few instructions. Larger or over-aligned
+ *             requests go to the global operator new.
+ *
+ *             release() gives all the pages back at once. It may only be
+ *             called once the blocks are not deallocated anymore, i.e. the
+ *             buffers using them are destroyed or abandoned. The arena is not
+ *             thread safe.
+ */
+class slab_arena {
+  private:
+    struct free_block {
+        free_block* next;
+    };
+
+    struct size_class {
+        free_block* free{nullptr};
+        std::byte* next{nullptr};
+        std::byte* end{nullptr};
+    };
+
+  public:
+    static constexpr int64_t min_block = 16;
+    static constexpr int64_t max_block = 4096;
+    static constexpr int64_t page_size = 1 << 16;
+
+  private:
+    static constexpr int64_t class_count =
+        std::bit_width(uint64_t(max_block / min_block));
+
+    std::array<size_class, class_count> _classes{};
+    std::vector<std::byte*> _pages{};
+
+
+  private:
+    /**
+     * @brief      Gets the size class of a request.
+     *
+     * @param[in]  bytes  The requested size, at most max_block.
+     *
+     * @return     The size class index.
+     */
+    static constexpr int64_t class_of(int64_t bytes) {
+        return std::bit_width(uint64_t(std::max(bytes, min_block) - 1)) -
+               std::bit_width(uint64_t(min_block - 1));
+    }
+
+
+    /**
+     * @brief      Checks if a request is served by the global operator new.
+     *
+     * @param[in]  bytes  The requested size.
+     * @param[in]  align  The requested alignment.
+     *
+     * @return     True iff the request is too large or over-aligned.
+     */
+    static constexpr bool is_large(int64_t bytes, int64_t align) {
+        return bytes > max_block || align > min_block;
+    }
+
+
+  public:
+    /**
+     * @brief      Constructs a new instance of slab arena.
+     */
+    slab_arena() = default;
+
+
+    slab_arena(const slab_arena&) = delete;
+    slab_arena& operator=(const slab_arena&) = delete;
+
+
+    /**
+     * @brief      Releases all the pages and destroys the object.
+     */
+    ~slab_arena() { release(); }
+
+
+  public:
+    /**
+     * @brief      Allocates a block.
+     *
+     * @param[in]  bytes  The requested size.
+     * @param[in]  align  The requested alignment.
+     *
+     * @return     The block.
+     */
+    void* allocate(int64_t bytes, int64_t align) {
+        if (is_large(bytes, align)) {
+            return ::operator new(bytes, std::align_val_t(align));
+        }
+        auto& c = _classes[class_of(bytes)];
+        if (c.free) {
+            return std::exchange(c.free, c.free->next);
+        }
+        int64_t block = min_block << class_of(bytes);
+        if (c.next == c.end) {
+            c.next = _pages.emplace_back(
+                static_cast<std::byte*>(::operator new(page_size)));
+            c.end = c.next + page_size;
+        }
+        return std::exchange(c.next, c.next + block);
+    }
+
+
+    /**
+     * @brief      Deallocates a block obtained from allocate().
+     *
+     * @param      p      The block.
+     * @param[in]  bytes  The size it was allocated with.
+     * @param[in]  align  The alignment it was allocated with.
+     */
+    void deallocate(void* p, int64_t bytes, int64_t align) {
+        if (is_large(bytes, align)) {
+            ::operator delete(p, std::align_val_t(align));
+            return;
+        }
+        auto& c = _classes[class_of(bytes)];
+        c.free = ::new (p) free_block{c.free};
+    }
+
+
+    /**
+     * @brief      Gives all the pages back at once, invalidating every block
+     *             served from them.
+     */
+    void release() {
+        for (auto* page : _pages) { ::operator delete(page); }
+        _pages.clear();
+        _classes = {};
+    }
+
+
+    /**
+     * @brief      Gets the number of pages held by the arena.
+     *
+     * @return     The number of pages.
+     */
+    int64_t page_count() const { return _pages.size(); }
+};
+
+
+/**
+ * @brief      Allocator handing out the blocks of a slab_arena, meant to be
+ *             plugged into gap_buffer. All the copies of an allocator share
+ *             the arena, which has to outlive them.
+ *
+ * @tparam     T     The allocated type.
+ */
+template <typename T>
+class slab_allocator {
+  private:
+    template <typename U>
+    friend class slab_allocator;
+
+  private:
+    slab_arena* _arena;
+
+
+  public:
+    using value_type = T;
+
+
+    /**
+     * @brief      Constructs a new instance of slab allocator.
+     *
+     * @param      arena  The arena.
+     */
+    slab_allocator(slab_arena& arena) : _arena{&arena} {}
+
+
+    /**
+     * @brief      Constructs a new instance of slab allocator sharing the
+     *             arena of another one.
+     *
+     * @param[in]  other  The other allocator.
+     */
+    template <typename U>
+    slab_allocator(const slab_allocator<U>& other) : _arena{other._arena} {}
+
+
+  public:
+    /**
+     * @brief      Allocates storage for \p n objects.
+     *
+     * @param[in]  n     The number of objects.
+     *
+     * @return     The storage.
+     */
+    T* allocate(size_t n) {
+        return static_cast<T*>(_arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+
+    /**
+     * @brief      Deallocates storage obtained from allocate().
+     *
+     * @param      p     The storage.
+     * @param[in]  n     The number of objects it was allocated for.
+     */
+    void deallocate(T* p, size_t n) {
+        _arena->deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+
+    template <typename U>
+    bool operator==(const slab_allocator<U>& other) const {
+        return _arena == other._arena;
+    }
+};
@@ -0,0 +1,159 @@
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+
+/**
+ * @brief      This class describes a work stealing thread pool. Every worker
+ *             owns a task deque. Tasks submitted by a worker go to its own
+ *             deque and are taken from the back, which keeps related work on
+ *             one thread, while idle workers steal from the front of the
+ *             other deques. Tasks submitted from outside are spread round
+ *             robin. The destructor runs all the remaining tasks before
+ *             joining the workers.
+ */
+class thread_pool {
+  private:
+    using task_t = std::function<void()>;
+
+    struct task_queue {
+        std::mutex mutex;
+        std::deque<task_t> tasks;
+    };
+
+  private:
+    int64_t _size;
+    std::unique_ptr<task_queue[]> _queues;
+    std::vector<std::jthread> _workers{};
+    std::atomic<int64_t> _pending{0};
+    std::atomic<uint64_t> _next{0};
+    std::mutex _idle_mutex{};
+    std::condition_variable _idle{};
+    bool _stop{false};
+
+    static inline thread_local const thread_pool* _current_pool{nullptr};
+    static inline thread_local int64_t _current_worker{0};
+
+
+  private:
+    /**
+     * @brief      Takes a task, preferably from the back of the worker's own
+     *             deque, otherwise from the front of another one.
+     *
+     * @param[in]  self  The worker index.
+     *
+     * @return     The task, if any was found.
+     */
+    std::optional<task_t> take(int64_t self) {
+        int64_t n = size();
+        for (int64_t k = 0; k < n; ++k) {
+            auto& queue = _queues[(self + k) % n];
+            std::scoped_lock lock{queue.mutex};
+            if (queue.tasks.empty()) { continue; }
+            task_t task;
+            if (k == 0) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            } else {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+            --_pending;
+            return task;
+        }
+        return std::nullopt;
+    }
+
+
+    /**
+     * @brief      The loop run by every worker.
+     *
+     * @param[in]  self  The worker index.
+     */
+    void run(int64_t self) {
+        _current_pool = this;
+        _current_worker = self;
+        while (true) {
+            if (auto task = take(self)) {
+                (*task)();
+                continue;
+            }
+            std::unique_lock lock{_idle_mutex};
+            _idle.wait(lock, [this] { return _stop || _pending > 0; });
+            if (_stop && _pending == 0) { return; }
+        }
+    }
+
+
+  public:
+    /**
+     * @brief      Constructs a new instance of thread pool.
+     *
+     * @param[in]  threads  The number of workers.
+     */
+    explicit thread_pool(
+        int64_t threads = std::max(1u, std::thread::hardware_concurrency()))
+        : _size{std::max<int64_t>(threads, 1)},
+          _queues{std::make_unique<task_queue[]>(_size)} {
+        for (int64_t i = 0; i < _size; ++i) {
+            _workers.emplace_back([this, i] { run(i); });
+        }
+    }
+
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+
+    /**
+     * @brief      Runs the remaining tasks and destroys the object.
+     */
+    ~thread_pool() {
+        {
+            std::scoped_lock lock{_idle_mutex};
+            _stop = true;
+        }
+        _idle.notify_all();
+        _workers.clear();
+    }
+
+
+  public:
+    /**
+     * @brief      Gets the number of workers.
+     *
+     * @return     The number of workers.
+     */
+    int64_t size() const { return _size; }
+
+
+    /**
+     * @brief      Schedules a task.
+     *
+     * @param[in]  task  The task.
+     */
+    void submit(task_t task) {
+        int64_t i = _current_pool == this ? _current_worker
+                                          : int64_t(_next++ % size());
+        {
+            std::scoped_lock lock{_idle_mutex};
+            ++_pending;
+        }
+        {
+            std::scoped_lock lock{_queues[i].mutex};
+            _queues[i].tasks.push_back(std::move(task));
+        }
+        _idle.notify_one();
+    }
+};
@@ -0,0 +1,163 @@
+#pragma once
+
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "block_map.hpp"
+#include "gap_buffer.hpp"
+
+
+/**
+ * @brief      This class describes a trigram index speeding up repeated
+ *             searches over a large gap_buffer<char>. The content is split
+ *             into blocks (see block_map) and every block keeps a hashed
+ *             signature of the trigrams starting in it. A search first skips
+ *             the blocks whose signatures lack some trigram of the needle and
+ *             only verifies the remaining candidates with
+ *             gap_buffer::find(). Signatures are used instead of posting
+ *             lists, so that an edit only has to rebuild the signatures of
+ *             the blocks it touched. Needles shorter than three characters
+ *             are not filtered at all.
+ */
+class trigram_index : public buffer_subscription<gap_buffer<char>> {
+  private:
+    static constexpr int64_t signature_bits = 1 << 16;
+
+    using signature = std::vector<uint64_t>;
+
+  private:
+    block_map<signature> _blocks;
+
+
+  private:
+    /**
+     * @brief      Hashes a trigram into a signature bit.
+     *
+     * @param[in]  trigram  The trigram packed into the lowest 24 bits.
+     *
+     * @return     The bit index.
+     */
+    static constexpr uint64_t bit_of(uint32_t trigram) {
+        return (trigram * uint64_t{0x9E3779B1} >> 16) % signature_bits;
+    }
+
+
+    /**
+     * @brief      Recomputes the signature of a block. It covers the
+     *             trigrams starting in the block, so it reads up to two
+     *             characters of the following blocks.
+     *
+     * @param[in]  i     The block index.
+     */
+    void index_block(int64_t i) {
+        auto& sig = _blocks.payload(i);
+        sig.assign(signature_bits / 64, 0);
+        int64_t begin = _blocks.block_begin(i);
+        int64_t end = std::min(begin + _blocks.block_size(i) + 2, _buf->size());
+        uint32_t trigram = 0;
+        int64_t pos = begin;
+        for (auto seg : _buf->segments(begin, end - begin)) {
+            for (char c : seg) {
+                trigram = (trigram << 8 | uint8_t(c)) & 0xFFFFFF;
+                if (++pos - begin >= 3) {
+                    uint64_t bit = bit_of(trigram);
+                    sig[bit / 64] |= uint64_t{1} << (bit % 64);
+                }
+            }
+        }
+    }
+
+
+    /**
+     * @brief      Checks if an occurrence of a needle might start in a block.
+     *             The trigrams of an occurrence crossing the block end start
+     *             in the following blocks, so their signatures are consulted
+     *             too.
+     *
+     * @param[in]  i       The block index.
+     * @param[in]  bits    The signature bits of the trigrams of the needle.
+     * @param[in]  length  The length of the needle.
+     *
+     * @return     False if the block certainly contains no occurrence.
+     */
+    bool candidate(int64_t i, const std::vector<uint64_t>& bits,
+                   int64_t length) const {
+        for (uint64_t bit : bits) {
+            bool found = false;
+            for (int64_t j = i, past = 0; !found && j < _blocks.size(); ++j) {
+                if (j > i) {
+                    if (past >= length - 2) { break; }
+                    past += _blocks.block_size(j);
+                }
+                found = _blocks.payload(j)[bit / 64] >> (bit % 64) & 1;
+            }
+            if (!found) { return false; }
+        }
+        return true;
+    }
+
+
+  public:
+    /**
+     * @brief      Constructs a new instance of trigram index over the given
+     *             buffer. The buffer has to outlive the index.
+     *
+     * @param      buf         The indexed buffer.
+     * @param[in]  block_size  The nominal size of a block.
+     */
+    trigram_index(gap_buffer<char>& buf, int64_t block_size = 1 << 16)
+        : buffer_subscription{buf}, _blocks{buf.size(), block_size} {
+        for (int64_t i = 0; i < _blocks.size(); ++i) { index_block(i); }
+    }
+
+
+  public:
+    /**
+     * @brief      Rebuilds the signatures of the edited blocks and of the
+     *             blocks whose trailing trigrams reach into them.
+     *
+     * @param[in]  offset    The content index at which the edit happened.
+     * @param[in]  removed   The number of removed characters.
+     * @param[in]  inserted  The number of inserted characters.
+     */
+    void on_edit(int64_t offset, int64_t removed, int64_t inserted) override {
+        auto touched = _blocks.edit(offset, removed, inserted);
+        int64_t first = touched.first;
+        for (int64_t reach = 2; first > 0 && reach > 0;) {
+            reach -= _blocks.block_size(--first);
+        }
+        for (int64_t i = first; i < touched.last; ++i) { index_block(i); }
+    }
+
+
+    /**
+     * @brief      Finds the first occurrence of \p needle starting at or
+     *             after \p from.
+     *
+     * @param[in]  needle  The searched string.
+     * @param[in]  from    The index the search starts at.
+     *
+     * @return     The index of the occurrence, if any.
+     */
+    std::optional<int64_t> find(std::string_view needle, int64_t from = 0) {
+        int64_t m = needle.size();
+        std::vector<uint64_t> bits;
+        for (int64_t k = 0; k + 3 <= m; ++k) {
+            bits.push_back(bit_of(uint8_t(needle[k]) << 16 |
+                                  uint8_t(needle[k + 1]) << 8 |
+                                  uint8_t(needle[k + 2])));
+        }
+        auto [i, begin] = _blocks.locate(from);
+        for (; i < _blocks.size(); begin += _blocks.block_size(i++)) {
+            if (!candidate(i, bits, m)) { continue; }
+            int64_t first = std::max(begin, from);
+            int64_t last = std::min(begin + _blocks.block_size(i) + m - 1,
+                                    _buf->size());
+            if (auto hit = _buf->find(needle, first, last)) { return hit; }
+        }
+        return std::nullopt;
+    }
+};
@@ -0,0 +1,201 @@
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gap_buffer.hpp"
+#include "thread_pool.hpp"
+
+
+/**
+ * @brief      Describes an occurrence found by a workspace search.
+ */
+struct workspace_match {
+    int64_t buffer;
+    int64_t offset;
+
+    constexpr bool operator==(const workspace_match&) const = default;
+};
+
+
+/**
+ * @brief      This class describes a search for a string over many buffers
+ *             at once. The content is split into blocks and each block is
+ *             searched as a separate task of a thread pool. The constructor
+ *             snapshots the buffers by copying the slice of every block,
+ *             extended by the needle length minus one so that occurrences
+ *             crossing the block end are found. The slices are copied in
+ *             parallel by the pool and the calling thread. The constructor
+ *             blocks until all of them are copied, i.e. for one copy of
+ *             the buffers split among the threads, after which the caller
+ *             can go on editing the buffers. Results are streamed by next()
+ *             in the (buffer, offset) order as soon as all the preceding
+ *             blocks are done.
+ */
+class workspace_search {
+  private:
+    struct block_task {
+        std::vector<int64_t> offsets{};
+        bool done{false};
+    };
+
+    struct block_ref {
+        int64_t buffer;
+        int64_t offset;
+    };
+
+    struct shared_state {
+        std::mutex mutex{};
+        std::condition_variable ready{};
+        std::vector<block_ref> blocks{};
+        std::vector<const gap_buffer<char>*> buffers{};
+        std::vector<std::string> slices{};
+        std::atomic<int64_t> next_slice{0};
+        int64_t copied{0};
+        int64_t block_size{0};
+        int64_t overlap{0};
+        std::vector<block_task> tasks{};
+    };
+
+  private:
+    std::shared_ptr<shared_state> _state;
+    int64_t _task{0};
+    int64_t _match{0};
+
+
+  private:
+    /**
+     * @brief      Copies the slices of the blocks not claimed by another
+     *             thread yet. Once all the blocks are claimed, the buffers
+     *             are not touched anymore, so a late call is harmless.
+     *
+     * @param      state  The state of the search.
+     */
+    static void copy_slices(shared_state& state) {
+        int64_t count = state.blocks.size();
+        for (int64_t t; (t = state.next_slice++) < count;) {
+            auto [b, offset] = state.blocks[t];
+            const auto* buf = state.buffers[b];
+            int64_t length = std::min(state.block_size + state.overlap,
+                                      buf->size() - offset);
+            std::string slice;
+            slice.reserve(length);
+            for (auto seg : buf->segments(offset, length)) {
+                slice.append(seg.begin(), seg.end());
+            }
+            state.slices[t] = std::move(slice);
+            {
+                std::scoped_lock lock{state.mutex};
+                ++state.copied;
+            }
+            state.ready.notify_all();
+        }
+    }
+
+
+    /**
+     * @brief      Searches the slice of a block and publishes the offsets of
+     *             the occurrences starting in the block.
+     *
+     * @param      state   The state of the search.
+     * @param[in]  needle  The searched string.
+     * @param[in]  t       The block index.
+     */
+    static void search_block(shared_state& state, std::string_view needle,
+                             int64_t t) {
+        std::string_view haystack = state.slices[t];
+        int64_t end = std::min<int64_t>(state.block_size, haystack.size());
+        std::vector<int64_t> offsets;
+        for (auto pos = haystack.find(needle);
+             pos != std::string_view::npos && int64_t(pos) < end;
+             pos = haystack.find(needle, pos + 1)) {
+            offsets.push_back(state.blocks[t].offset + pos);
+        }
+        std::string{}.swap(state.slices[t]);
+        {
+            std::scoped_lock lock{state.mutex};
+            state.tasks[t] = {std::move(offsets), true};
+        }
+        state.ready.notify_all();
+    }
+
+
+  public:
+    /**
+     * @brief      Constructs a new instance of workspace search and schedules
+     *             it on the given pool. It may be called from a task of the
+     *             pool, as the calling thread copies the slices too.
+     *
+     * @param      pool        The pool running the search.
+     * @param[in]  buffers     The searched buffers. They are only read by the
+     *                         constructor.
+     * @param[in]  needle      The searched string.
+     * @param[in]  block_size  The size of a block searched by one task. It
+     *                         is raised to 1 if smaller.
+     */
+    workspace_search(thread_pool& pool,
+                     std::span<gap_buffer<char>* const> buffers,
+                     std::string needle, int64_t block_size = 1 << 20)
+        : _state{std::make_shared<shared_state>()} {
+        auto& state = *_state;
+        state.block_size = std::max<int64_t>(block_size, 1);
+        state.overlap = std::max<int64_t>(needle.size(), 1) - 1;
+        for (int64_t b = 0; b < int64_t(buffers.size()); ++b) {
+            state.buffers.push_back(buffers[b]);
+            for (int64_t offset = 0; offset < buffers[b]->size();
+                 offset += state.block_size) {
+                state.blocks.push_back({b, offset});
+            }
+        }
+        int64_t count = state.blocks.size();
+        state.slices.resize(count);
+        state.tasks.resize(count);
+        for (int64_t i = 0; i < std::min(count - 1, pool.size()); ++i) {
+            pool.submit([state = _state] { copy_slices(*state); });
+        }
+        copy_slices(state);
+        {
+            std::unique_lock lock{state.mutex};
+            state.ready.wait(lock, [&] { return state.copied == count; });
+        }
+        auto shared_needle = std::make_shared<const std::string>(needle);
+        for (int64_t t = 0; t < count; ++t) {
+            pool.submit([state = _state, shared_needle, t] {
+                search_block(*state, *shared_needle, t);
+            });
+        }
+    }
+
+
+  public:
+    /**
+     * @brief      Gets the next occurrence, waiting for the tasks it depends
+     *             on if needed.
+     *
+     * @return     The next occurrence or nothing if the search is over.
+     */
+    std::optional<workspace_match> next() {
+        std::unique_lock lock{_state->mutex};
+        while (_task < int64_t(_state->blocks.size())) {
+            auto& task = _state->tasks[_task];
+            _state->ready.wait(lock, [&task] { return task.done; });
+            if (_match < int64_t(task.offsets.size())) {
+                return workspace_match{_state->blocks[_task].buffer,
+                                       task.offsets[_match++]};
+            }
+            ++_task;
+            _match = 0;
+        }
+        return std::nullopt;
+    }
+};
@@ -1,6 +1,22 @@
+#include <atomic>
+#include <coroutine>
+#include <exception>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
 
+#include "block_map.hpp"
+#include "bracket_index.hpp"
+#include "edit_strand.hpp"
 #include "gap_buffer.hpp"
+#include "incremental_lexer.hpp"
+#include "line_gap_buffer.hpp"
+#include "parallel_algorithm.hpp"
+#include "shared_gap_buffer.hpp"
+#include "slab_allocator.hpp"
+#include "trigram_index.hpp"
+#include "workspace_search.hpp"
 
 
 constexpr bool equal(auto str1, std::string_view str2) {
@@ -8,6 +24,68 @@ constexpr bool equal(auto str1, std::string_view str2) {
 }
 
 
+static_assert(std::ranges::random_access_range<gap_buffer<char>>);
+static_assert(std::ranges::random_access_range<const gap_buffer<char>>);
+static_assert(std::is_nothrow_move_constructible_v<gap_buffer<char>>);
+static_assert(std::is_nothrow_swappable_v<gap_buffer<char>>);
+static_assert(sizeof(gap_buffer<int>) <
+              sizeof(gap_buffer<char>) - sizeof(text_stats));
+
+
+/**
+ * Lexes words, blanks and double quoted strings. An unclosed quote turns
+ * the rest of the content into a string.
+ */
+struct quote_lexer {
+    enum state_type { blank, quoted, closing_quote, word };
+
+    constexpr state_type initial() const { return blank; }
+
+    constexpr state_type step(state_type state, char c) const {
+        if (state == quoted) { return c == '"' ? closing_quote : quoted; }
+        return c == '"' ? quoted : c == ' ' ? blank : word;
+    }
+
+    constexpr int64_t kind(state_type state) const {
+        return state == closing_quote ? quoted : state;
+    }
+};
+
+
+/**
+ * Joins the adjacent tokens of the same kind, which the lexer driver keeps
+ * apart at block boundaries.
+ */
+constexpr std::vector<token> merged(const std::vector<token>& tokens) {
+    std::vector<token> result;
+    for (auto t : tokens) {
+        if (!result.empty() && result.back().kind == t.kind) {
+            result.back().length += t.length;
+        } else {
+            result.push_back(t);
+        }
+    }
+    return result;
+}
+
+
+/**
+ * Records the edits it is told about.
+ */
+struct edit_recorder : edit_observer {
+    std::vector<edit_range> edits{};
+
+    // Spelled out, as GCC 12 rejects the implicit one in constant
+    // expressions.
+    constexpr ~edit_recorder() override {}
+
+    constexpr void on_edit(int64_t offset, int64_t removed,
+                           int64_t inserted) override {
+        edits.push_back({offset, removed, inserted});
+    }
+};
+
+
 consteval auto test() {
     using namespace std::string_view_literals;
     gap_buffer<char> gb;
@@ -43,9 +121,143 @@ consteval auto test() {
     bool t15 = equal(gb.view(), "***#&&&buffer abc"sv);
     bool t16 = gb.back() == 'c';
     bool t17 = gb.front() == '*';
+    gb.clear();
+    gb.push_back("first\nsecond\n\nfourth"sv);
+    gb.insert(9, "__"sv);
+    bool t18 = gb.line_count() == 4 && gb.line_start(2) == 15;
+    auto visible = gb.lines(1, 10);
+    bool t19 = std::ranges::equal(
+        visible, std::array{"sec__ond"sv, ""sv, "fourth"sv});
+    gb.remove(5, 3);
+    gb.insert(0, "  zeroth "sv);
+    bool t20 = gb.stats() == text_stats{28, 3, 3} &&
+               gb.stats() == gb.recount_stats();
+    gb.clear();
+    gb.push_back("f(a[i], {b}) + g()"sv);
+    bracket_index brackets(gb, 4);
+    gb.insert(3, "(x)"sv);
+    bool t21 = brackets.match(1) == 14 && brackets.match(8) == 6 &&
+               brackets.enclosing(12) == std::pair<int64_t, int64_t>{11, 13};
+    gb.insert(8, "+"sv);
+    bool t22 = gb.find("(x)[i+]"sv) == 3 && gb.find("+"sv, 9) == 17 &&
+               !gb.find("x)["sv, 0, 6);
+    gb.transform_range(0, 8, [](char c) { return c == 'x' ? 'y' : c; });
+    bool t23 = equal(gb.view(), "f(a(y)[i+], {b}) + g()"sv);
+    gb.clear();
+    gb.insert_n(0, 3, ' ');
+    gb.insert_repeat(3, 5, "ab"sv);
+    gb.insert_n(13, 0, '#');
+    bool t24 = equal(gb.view(), "   ababababab"sv);
+    gb.erase_ranges(std::array{std::pair{0L, 2L}, std::pair{4L, 6L}});
+    gb.erase_if([](char c) { return c == 'b'; });
+    bool t25 = equal(gb.view(), " aaaa"sv);
+    gb.clear();
+    gb.insert("ab\ncd\n\nef"sv);
+    gb.insert_column(0, 4, 1, "||");
+    bool t26 = equal(gb.view(), "a||b\nc||d\n||\ne||f"sv);
+    gb.erase_column(1, 3, 0, 2);
+    t26 = t26 && equal(gb.view(), "a||b\n|d\n\ne||f"sv);
+    line_gap_buffer lb{"first\nsecond"sv};
+    lb.move_cursor(0, 3);
+    lb.insert("\nnew\n"sv);
+    lb.move_cursor(2, 2);
+    lb.remove(4);
+    bool t27 = lb.text() == "fir\nnew\nstond" && lb.line_count() == 3;
+    const auto& cgb = gb;
+    auto [cl, cr] = cgb.segments(1, 3);
+    bool t28 = equal(cgb.view(), "a||b\n|d\n\ne||f"sv) &&
+               cgb.front() == 'a' && cgb.back() == 'f' &&
+               cl.size() + cr.size() == 3 && cgb.find("|d"sv) == 5;
+    auto it = std::ranges::find(gb, 'd');
+    gb.insert(0, "xy"sv);
+    bool t29 = it.stale() && *it == '\n' && *(it + 2) == 'd' &&
+               gb.end() - it == 9 && std::ranges::equal(gb, gb.view());
+    auto [rr, rl] = gb.rsegments();
+    bool t30 = gb.rfind('\n', gb.size(), 2) == 9 && gb.rfind('|', 4) == 3 &&
+               !gb.rfind('z', gb.size()) &&
+               rl.data() == gb.segments()[0].data();
+    gap_buffer<char16_t> wide;
+    wide.insert_n(0, 20, u'a');
+    wide.insert(5, u"xyz"sv);
+    gb.transform_range(0, 2, kernels::to_upper{});
+    bool t31 = wide.find(u"yz"sv) == 6 && wide.rfind(u'x', 20) == 5 &&
+               wide.rfind(u'a', wide.size(), 18) == 2 &&
+               gb.front() == 'X' && gb.begin()[1] == 'Y';
+    gap_buffer<char> copy{gb, 2};
+    copy.insert(0, "ab"sv);
+    auto moved = std::move(copy);
+    std::vector<gap_buffer<char>> many(1, gb);
+    const char* storage = many[0].segments()[0].data();
+    for (int i = 0; i < 8; ++i) { many.emplace_back(gb, 0); }
+    std::ranges::swap(many[0], moved);
+    bool t32 = copy.empty() && copy.line_count() == 1 &&
+               std::ranges::equal(many[1], gb) &&
+               many[8].line_start(2) == gb.line_start(2) &&
+               moved.segments()[0].data() == storage &&
+               many[0].size() == gb.size() + 2 && many[0].line_count() == 4;
+    gap_buffer<char> indexed;
+    std::vector<gap_buffer<char>> owners;
+    indexed.insert(0, "(a)"sv);
+    bracket_index idx{indexed, 2};
+    owners.push_back(std::move(indexed));
+    owners.emplace_back();
+    owners[0].insert(0, "(("sv);
+    std::ranges::swap(owners[0], owners[1]);
+    bool t33 = idx.match(4) == 2 && idx.match(0) == std::nullopt &&
+               indexed.empty();
+    gap_buffer<char> target;
+    bracket_index target_idx{target};
+    target = std::move(owners[1]);
+    t33 = t33 && target_idx.match(4) == 2 && !idx.match(4) &&
+          owners[1].empty();
+    block_map<int> blocks{8, 4};
+    auto edited = blocks.edit(2, 6, 7);
+    bool t34 = edited.reindexed && edited.last == 2 && blocks.size() == 2 &&
+               blocks.block_size(0) == 4 && blocks.block_size(1) == 5;
+    gap_buffer<char> source;
+    source.insert(0, "ab cd ef gh ij kl"sv);
+    incremental_lexer<quote_lexer> lexer{source, {}, 4};
+    source.remove(1, 1);
+    source.insert(1, "q"sv);
+    bool t35 = lexer.relexed() == 1 &&
+               lexer.tokens(0, 3) == std::vector<token>{{0, 2, 3}, {2, 1, 0}};
+    source.insert(0, "\""sv);
+    bool t36 = lexer.relexed() == 5 &&
+               merged(lexer.tokens(0, source.size())) ==
+                   std::vector<token>{{0, 18, 1}};
+    source.insert(7, "\" "sv);
+    {
+        incremental_lexer<quote_lexer> full{source, {}, 4};
+        t36 = t36 && merged(lexer.tokens(0, source.size())) ==
+                         merged(full.tokens(0, source.size()));
+    }
+    gap_buffer<char> batched;
+    batched.insert(0, "abcdef"sv);
+    edit_recorder recorder;
+    batched.subscribe(recorder);
+    batched.begin_batch();
+    batched.insert(2, "xy"sv);
+    batched.remove(3, 2);
+    batched.begin_batch();
+    batched.insert(6, "!"sv);
+    bool t37 = recorder.edits == std::vector<edit_range>{{2, 1, 1}};
+    batched.insert(7, "?"sv);
+    batched.end_batch();
+    t37 = t37 && recorder.edits.size() == 1;
+    batched.end_batch();
+    t37 = t37 && equal(batched.view(), "abxdef!?"sv) &&
+          recorder.edits == std::vector<edit_range>{{2, 1, 1}, {6, 0, 2}};
+    batched.unsubscribe(recorder);
+    batched.erase_if([](char c) { return c == 'x'; }, batched.size() + 1);
+    batched.insert('<');
+    batched.erase_ranges(std::array{std::pair{0L, 1L}}, -4);
+    batched.insert('>');
+    bool t38 = equal(batched.view(), ">bdef!?<"sv);
     // clang-format off
     return std::array{t1, t2, t3, t4, t5, t6, t7, t8, t9, t10,
-        t11, t12, t13, t14, t15, t16, t17};
+        t11, t12, t13, t14, t15, t16, t17, t18, t19, t20, t21, t22, t23, t24,
+        t25, t26, t27, t28, t29, t30, t31, t32, t33, t34, t35, t36,
+        t37, t38};
     // clang-format on
 }
 
@@ -73,6 +285,294 @@ void test2() {
 }
 
 
+bool test_parallel() {
+    thread_pool pool(4);
+    gap_buffer<char> gb;
+    std::string text;
+    for (int i = 0; i < 300000; ++i) { text += "ab\nc"[i % 7 % 4]; }
+    gb.insert(0, std::string_view{text});
+    gb.insert(100000, 'z');
+    text.insert(100000, 1, 'z');
+    std::atomic<int64_t> newlines{0};
+    for_each(pool, gb, [&](char c) { newlines += c == '\n'; });
+    auto is_c = [](char c) { return c == 'c'; };
+    bool ok = newlines == std::ranges::count(text, '\n') &&
+              count_if(pool, gb, is_c) == std::ranges::count_if(text, is_c) &&
+              find_if(pool, gb, [](char c) { return c == 'z'; }) == 100000 &&
+              !find_if(pool, gb, [](char c) { return c == 'y'; });
+    transform(pool, gb, [](char c) { return c == 'a' ? 'A' : c; });
+    std::ranges::replace(text, 'a', 'A');
+    ok = ok && std::ranges::equal(gb, text) &&
+         gb.stats() == gb.recount_stats();
+    try {
+        for_each(pool, gb, [](char c) {
+            if (c == 'z') { throw std::runtime_error("z"); }
+        });
+        ok = false;
+    } catch (const std::runtime_error&) {}
+    return ok;
+}
+
+
+bool test_exceptions() {
+    using namespace std::string_view_literals;
+    struct counter : edit_observer {
+        int64_t edits{0};
+        void on_edit(int64_t, int64_t, int64_t) override { ++edits; }
+    };
+    gap_buffer<char> gb;
+    gb.insert(0, "ab cd\nef a"sv);
+    gb.insert(3, 'a');
+    counter seen;
+    gb.subscribe(seen);
+    try {
+        gb.modify(0, gb.size(), [](std::array<std::span<char>, 2> segs) {
+            std::ranges::replace(segs[0], ' ', '_');
+            throw std::runtime_error("modify");
+        });
+    } catch (const std::runtime_error&) {}
+    bool ok = seen.edits == 1 && gb.stats() == gb.recount_stats() &&
+              gb.line_end(0) == 6;
+    try {
+        gb.erase_if([](char c) {
+            if (c == 'e') { throw std::runtime_error("erase_if"); }
+            return c == 'a';
+        });
+    } catch (const std::runtime_error&) {}
+    ok = ok && seen.edits == 2 && std::ranges::equal(gb, "b_cd\nef a"sv) &&
+         gb.stats() == gb.recount_stats() && gb.line_start(1) == 5;
+    gb.unsubscribe(seen);
+    // Relocating a buffer in the middle of a batch must not call a throwing
+    // observer from the noexcept move constructor.
+    struct thrower : edit_observer {
+        void on_edit(int64_t, int64_t, int64_t) override {
+            throw std::runtime_error("observer");
+        }
+    };
+    thrower failing;
+    std::vector<gap_buffer<char>> bufs(1);
+    bufs[0].subscribe(failing);
+    bufs[0].begin_batch();
+    bufs[0].insert(0, "xy"sv);
+    bufs.emplace_back();
+    bool thrown = false;
+    try {
+        bufs[0].end_batch();
+    } catch (const std::runtime_error&) { thrown = true; }
+    bufs[0].unsubscribe(failing);
+    ok = ok && thrown && std::ranges::equal(bufs[0], "xy"sv);
+    // An observer which throws does not keep the edit from the next ones.
+    bufs[1].subscribe(failing);
+    bufs[1].subscribe(seen);
+    thrown = false;
+    try {
+        bufs[1].insert(0, 'z');
+    } catch (const std::runtime_error&) { thrown = true; }
+    bufs[1].unsubscribe(failing);
+    bufs[1].unsubscribe(seen);
+    return ok && thrown && seen.edits == 3;
+}
+
+
+struct detached_task {
+    struct promise_type {
+        detached_task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+
+struct failing_observer : edit_observer {
+    std::atomic<bool> armed{false};
+
+    void on_edit(int64_t, int64_t, int64_t) override {
+        if (armed.exchange(false)) { throw std::runtime_error("observer"); }
+    }
+};
+
+
+detached_task type_into(edit_strand& strand, char c, int64_t count) {
+    for (int64_t i = 0; i < count; ++i) {
+        text_edit edit{i, 0, std::string(1, c)};
+        co_await strand.apply(std::move(edit));
+    }
+}
+
+
+detached_task edit_after_failure(edit_strand& strand,
+                                 failing_observer& observer, bool& ok) {
+    text_edit first{0, 0, "("};
+    co_await strand.apply(std::move(first));
+    observer.armed = true;
+    try {
+        text_edit failing{0, 0, "["};
+        co_await strand.apply(std::move(failing));
+        ok = false;
+    } catch (const std::runtime_error&) {}
+    text_edit last{0, 0, "{"};
+    co_await strand.apply(std::move(last));
+}
+
+
+bool test_strand() {
+    gap_buffer<char> gb;
+    failing_observer observer;
+    gb.subscribe(observer);
+    bool ok = true;
+    {
+        thread_pool pool(4);
+        edit_strand strand{gb, pool};
+        for (char c : {'a', 'b', 'c', 'd'}) { type_into(strand, c, 200); }
+        strand.wait_idle();
+        ok = gb.size() == 800 && gb.stats() == gb.recount_stats();
+        edit_after_failure(strand, observer, ok);
+    }
+    ok = ok && gb.size() == 803 && gb.front() == '{';
+    gb.unsubscribe(observer);
+    return ok;
+}
+
+
+bool test_shared() {
+    shared_gap_buffer shared{4096};
+    std::string pairs;
+    for (int i = 0; i < 100; ++i) { pairs += "ab"; }
+    shared.insert(0, pairs);
+    shared_gap_reader reader{shared.fd()};
+    std::atomic<bool> done{false};
+    std::thread writer{[&] {
+        for (int64_t i = 0; i < 100000; ++i) {
+            if (i % 2 == 0) {
+                shared.insert(2 * (i % 97), "ab");
+            } else {
+                shared.remove(2 * (i % 89), 2);
+            }
+        }
+        done = true;
+    }};
+    // Every edit keeps the content a run of "ab", so a snapshot mixing two
+    // versions would show up as a misplaced character.
+    auto alternating = [](std::array<std::string_view, 2> segments) {
+        int64_t pos = 0;
+        for (auto seg : segments) {
+            for (char c : seg) {
+                if (c != "ab"[pos++ % 2]) { return false; }
+            }
+        }
+        return pos % 2 == 0;
+    };
+    bool ok = true;
+    while (!done) { ok = ok && reader.read(alternating); }
+    writer.join();
+    shared.insert(shared.size() + 10, "ab");
+    shared.insert(-10, "ab");
+    return ok && reader.read(alternating) &&
+           shared.segments()[0].size() == 2 &&
+           reader.version() == 100000 + 3;
+}
+
+
+bool test_trigram() {
+    using namespace std::string_view_literals;
+    gap_buffer<char> gb;
+    gb.insert(0, "the quick brown fox jumps over the lazy dog"sv);
+    trigram_index index{gb, 8};
+    // Blocks of 8 characters: "quick" and "own fox" cross block ends.
+    bool ok = index.find("quick"sv) == 4 && index.find("own fox"sv) == 12 &&
+              index.find("the"sv, 1) == 31 && !index.find("quack"sv) &&
+              index.find("k"sv, 5) == 8 && index.find("z"sv) == 37 &&
+              index.find("g"sv) == 42 && !index.find("x"sv, 19);
+    // The new trigrams "n a" and " ar" start in the block preceding the
+    // edited one, so its signature has to be rebuilt too.
+    gb.insert(16, "ar"sv);
+    ok = ok && index.find("wn ar"sv) == 13 && index.find("arfox"sv) == 16;
+    gb.remove(4, 6);
+    for (auto needle : {"the"sv, "brown"sv, "wn arf"sv, "e b"sv, "dog"sv,
+                        "og"sv, "he"sv, "zy "sv, "own fox"sv}) {
+        ok = ok && index.find(needle) == gb.find(needle) &&
+             index.find(needle, 10) == gb.find(needle, 10);
+    }
+    return ok;
+}
+
+
+bool test_workspace() {
+    using namespace std::string_view_literals;
+    std::atomic<int64_t> runs{0};
+    {
+        thread_pool pool(0);
+        thread_pool* nested = &pool;
+        for (int i = 0; i < 1000; ++i) {
+            pool.submit([&runs, nested] {
+                ++runs;
+                nested->submit([&runs] { ++runs; });
+            });
+        }
+    }
+    bool ok = runs == 2000;
+    std::array<gap_buffer<char>, 3> bufs;
+    bufs[0].insert(0, "abab ab aab"sv);
+    bufs[2].insert(0, "ba"sv);
+    bufs[2].insert(1, "xab"sv);
+    std::vector<workspace_match> expected;
+    for (int64_t b = 0; b < 3; ++b) {
+        for (auto pos = bufs[b].find("ab"sv); pos;
+             pos = bufs[b].find("ab"sv, *pos + 1)) {
+            expected.push_back({b, *pos});
+        }
+    }
+    std::array<gap_buffer<char>*, 3> ptrs{&bufs[0], &bufs[1], &bufs[2]};
+    thread_pool pool(4);
+    for (int64_t block_size : {0, 1, 3, 1 << 20}) {
+        workspace_search search{pool, ptrs, "ab", block_size};
+        // The buffers are snapshotted by the time the constructor returns.
+        bufs[1].insert(0, "abab"sv);
+        std::vector<workspace_match> found;
+        while (auto match = search.next()) { found.push_back(*match); }
+        bufs[1].clear();
+        ok = ok && found == expected;
+    }
+    return ok && expected.size() == 5;
+}
+
+
+bool test_slab() {
+    using namespace std::string_view_literals;
+    slab_arena arena;
+    void* small = arena.allocate(24, 8);
+    arena.deallocate(small, 24, 8);
+    bool ok = arena.allocate(32, 8) == small && arena.page_count() == 1;
+    void* large = arena.allocate(slab_arena::max_block + 1, 8);
+    arena.deallocate(large, slab_arena::max_block + 1, 8);
+    ok = ok && arena.page_count() == 1;
+    using buffer = gap_buffer<char, slab_allocator<char>>;
+    std::vector<buffer> cells;
+    for (int i = 0; i < 1000; ++i) {
+        auto& cell = cells.emplace_back(slab_allocator<char>{arena});
+        cell.insert(0, "cell"sv);
+        cell.insert(2, std::string_view{std::to_string(i)});
+    }
+    cells[7].insert_n(0, 100, '-');
+    cells.erase(cells.begin() + 1, cells.end() - 1);
+    ok = ok && equal(cells[0].view(), "ce0ll"sv) &&
+         equal(cells[1].view(), "ce999ll"sv);
+    cells.clear();
+    arena.release();
+    return ok && arena.page_count() == 0;
+}
+
+
+void report(std::string_view name, bool passed) {
+    std::cout << name
+              << (passed ? std::string_view{" passed"}
+                         : std::string_view{" failed"})
+              << "\n";
+}
+
+
 int main(int argc, char const *argv[]) {
     constexpr auto results = test();
     for (auto [id, res] : std::views::enumerate(results)) {
@@ -82,5 +582,13 @@ int main(int argc, char const *argv[]) {
                   << "\n";
     }
     test2();
+    report("kernel self-check", kernels::self_check());
+    report("parallel algorithms", test_parallel());
+    report("exception safety", test_exceptions());
+    report("edit strand", test_strand());
+    report("shared gap buffer", test_shared());
+    report("trigram index", test_trigram());
+    report("workspace search", test_workspace());
+    report("slab allocator", test_slab());
     return 0;
 }
\ No newline at end of file